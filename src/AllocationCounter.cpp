@@ -0,0 +1,159 @@
+// global operator new and delete counting allocations for --time-report.
+// Linked into executables only, so library does not replace allocator of its users.
+// Counting does nothing until enableStats()
+#include "TranslationStats.h"
+
+#include <cstdlib>
+#include <new>
+
+static void* allocate(size_t size) {
+	countAllocation();
+	if (size == 0) size = 1;
+	while (true) {
+		if (void* p = std::malloc(size)) {
+			return p;
+		}
+		auto handler = std::get_new_handler();
+		if (handler == nullptr) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+static void* allocateAligned(size_t size, std::align_val_t alignment) {
+	countAllocation();
+	if (size == 0) size = 1;
+	auto align = static_cast<size_t>(alignment);
+	if (align < sizeof(void*)) align = sizeof(void*);
+	while (true) {
+#ifdef _WIN32
+		void* p = _aligned_malloc(size, align);
+#else
+		void* p = nullptr;
+		if (posix_memalign(&p, align, size) != 0) p = nullptr;
+#endif
+		if (p != nullptr) {
+			return p;
+		}
+		auto handler = std::get_new_handler();
+		if (handler == nullptr) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+static void release(void* p) noexcept {
+	std::free(p);
+}
+
+static void releaseAligned(void* p) noexcept {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void* operator new(size_t size) {
+	return allocate(size);
+}
+
+void* operator new[](size_t size) {
+	return allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return allocate(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return allocate(size);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return allocateAligned(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try {
+		return allocateAligned(size, alignment);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try {
+		return allocateAligned(size, alignment);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* p) noexcept {
+	release(p);
+}
+
+void operator delete[](void* p) noexcept {
+	release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	release(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	releaseAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+	releaseAligned(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+	releaseAligned(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+	releaseAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+	releaseAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+	releaseAligned(p);
+}
@@ -0,0 +1,302 @@
+#include "BatchTranslator.h"
+#include "TranslationUnitAction.h"
+#include "TranslationCache.h"
+#include "PreambleCache.h"
+#include "TranslationOptions.h"
+#include "TranslationStats.h"
+
+#include "clang/Basic/FileManager.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+
+namespace fs = std::filesystem;
+
+static bool isSourceFile(const fs::path& path) {
+	auto ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".cpp" || ext == ".cc" || ext == ".cxx" || ext == ".c";
+}
+
+static fs::path getOutputPath(const fs::path& source, const fs::path& relative, const std::string& outputDir) {
+	auto output = outputDir.empty() ? source : fs::path(outputDir) / relative;
+	output.replace_extension(getTranslationOptions().getOutputExtension());
+	return output;
+}
+
+namespace {
+
+class TranslationActionFactory : public clang::tooling::FrontendActionFactory {
+public:
+	TranslationActionFactory(OutputSink& out, std::vector<std::string>* headers, HeaderModuleRegistry* modules)
+		: out(out), headers(headers), modules(modules) {}
+
+	std::unique_ptr<clang::FrontendAction> create() override {
+		return std::make_unique<TranslationUnitAction>(out, headers, modules);
+	}
+private:
+	OutputSink& out;
+	std::vector<std::string>* headers;
+	HeaderModuleRegistry* modules;
+};
+
+// parses main file on top of shared precompiled preamble when other files start with the same includes
+class PreambleActionFactory : public TranslationActionFactory {
+public:
+	PreambleActionFactory(OutputSink& out, std::vector<std::string>* headers, HeaderModuleRegistry* modules,
+		PreambleCache& preambles, std::string key)
+		: TranslationActionFactory(out, headers, modules), headers(headers), preambles(preambles), key(std::move(key)) {}
+
+	bool runInvocation(std::shared_ptr<clang::CompilerInvocation> Invocation, clang::FileManager* Files,
+		std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps, clang::DiagnosticConsumer* DiagConsumer) override {
+		const auto& inputs = Invocation->getFrontendOpts().Inputs;
+		if (inputs.size() != 1 || !inputs.front().isFile()) {
+			return TranslationActionFactory::runInvocation(Invocation, Files, PCHContainerOps, DiagConsumer);
+		}
+
+		auto mainFile = Files->getBufferForFile(inputs.front().getFile());
+		if (!mainFile) {
+			return TranslationActionFactory::runInvocation(Invocation, Files, PCHContainerOps, DiagConsumer);
+		}
+
+		llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs(&Files->getVirtualFileSystem());
+		auto preamble = preambles.get(key, *Invocation, **mainFile, fs, PCHContainerOps);
+		if (preamble == nullptr) {
+			return TranslationActionFactory::runInvocation(Invocation, Files, PCHContainerOps, DiagConsumer);
+		}
+
+		// headers from PCH are not entered by preprocessor again
+		if (headers != nullptr) {
+			headers->insert(headers->end(), preamble->headers.begin(), preamble->headers.end());
+		}
+		auto originalFs = fs;
+		preamble->preamble.AddImplicitPreamble(*Invocation, fs, mainFile->get());
+		if (fs == originalFs) {
+			return TranslationActionFactory::runInvocation(Invocation, Files, PCHContainerOps, DiagConsumer);
+		}
+		llvm::IntrusiveRefCntPtr<clang::FileManager> files(new clang::FileManager(Files->getFileSystemOpts(), fs));
+		return TranslationActionFactory::runInvocation(Invocation, files.get(), PCHContainerOps, DiagConsumer);
+	}
+private:
+	std::vector<std::string>* headers;
+	PreambleCache& preambles;
+	std::string key;
+};
+
+// file may have several compile commands (debug/release, ...), translate it only once
+class FirstCommandDatabase : public clang::tooling::CompilationDatabase {
+public:
+	explicit FirstCommandDatabase(const clang::tooling::CompilationDatabase& base)
+		: base(base) {}
+
+	std::vector<clang::tooling::CompileCommand> getCompileCommands(llvm::StringRef FilePath) const override {
+		auto commands = base.getCompileCommands(FilePath);
+		if (commands.size() > 1) {
+			commands.resize(1);
+		}
+		return commands;
+	}
+private:
+	const clang::tooling::CompilationDatabase& base;
+};
+
+}
+
+// caching file system of worker with unsaved buffers on top of it
+static llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> createWorkerFileSystem(TranslationSession& session) {
+	auto files = createCachingFileSystem(session.files);
+	if (session.unsaved == nullptr) {
+		return files;
+	}
+	llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> overlay(new llvm::vfs::OverlayFileSystem(files));
+	overlay->pushOverlay(session.unsaved);
+	return overlay;
+}
+
+// files without compilation database are parsed with default flags
+static clang::tooling::FixedCompilationDatabase getDefaultDatabase() {
+	return clang::tooling::FixedCompilationDatabase(fs::current_path().string(), {});
+}
+
+// input is read by FileManager (memory mapped when large) and is not copied before parsing
+static bool translateWithCompileCommand(const std::string& input, OutputSink& out,
+	TranslationSession& session, std::vector<std::string>* headers) {
+	auto defaultDatabase = getDefaultDatabase();
+	FirstCommandDatabase database(session.compilations != nullptr ? *session.compilations : defaultDatabase);
+	clang::tooling::ClangTool tool(database, { input },
+		std::make_shared<clang::PCHContainerOperations>(), createWorkerFileSystem(session));
+
+	// preambles and header modules outlive request, so unsaved buffers must not get into them
+	auto* modules = session.unsaved == nullptr ? session.modules : nullptr;
+	if (session.preambles != nullptr && session.unsaved == nullptr) {
+		// preamble may be shared by files with the same flags in the same directory
+		auto commands = database.getCompileCommands(input);
+		std::string key = llvm::sys::path::parent_path(input).str();
+		if (!commands.empty()) {
+			key += "\n" + commands.front().Directory;
+			for (const auto& arg : commands.front().CommandLine) {
+				key += "\n" + (arg == commands.front().Filename || arg == input ? std::string("<input>") : arg);
+			}
+		}
+		PreambleActionFactory factory(out, headers, modules, *session.preambles, key);
+		return tool.run(&factory) == 0;
+	}
+
+	TranslationActionFactory factory(out, headers, modules);
+	return tool.run(&factory) == 0;
+}
+
+static bool translateSource(const std::string& input, OutputSink& out,
+	TranslationSession& session, std::vector<std::string>* headers) {
+	std::error_code ec;
+	bool isUnsaved = session.unsaved != nullptr && session.unsaved->exists(input);
+	if (!isUnsaved && !fs::is_regular_file(input, ec)) {
+		return false;
+	}
+	return translateWithCompileCommand(input, out, session, headers);
+}
+
+// everything that changes parsing of input is a part of cache key
+static std::vector<std::string> getCompileFlags(const std::string& input, const TranslationSession& session) {
+	std::vector<std::string> flags;
+	if (session.compilations != nullptr) {
+		auto commands = session.compilations->getCompileCommands(input);
+		if (!commands.empty()) {
+			flags = commands.front().CommandLine;
+			flags.push_back(commands.front().Directory);
+		}
+	}
+	flags.push_back(getTranslationOptions().getFingerprint());
+	return flags;
+}
+
+bool translateFile(const std::string& input, OutputSink& out, TranslationSession& session) {
+	// cache entry is found by content of files on disk, not by unsaved buffers
+	if (session.cache == nullptr || session.unsaved != nullptr) {
+		return translateSource(input, out, session, nullptr);
+	}
+
+	// header modules of stored translation may be deleted with output directory
+	auto flags = getCompileFlags(input, session);
+	if (auto python = session.cache->lookup(input, flags);
+		python && (session.modules == nullptr || session.modules->hasImportedModules(*python))) {
+		PhaseScope phase(Phase::Emission);
+		out << *python;
+		return true;
+	}
+
+	std::string python;
+	std::vector<std::string> headers;
+	llvm::raw_string_ostream str(python);
+	bool isTranslated = translateSource(input, str, session, &headers);
+	str.flush();
+
+	// failed translation is not stored, errors are reported again on next run
+	if (isTranslated) {
+		session.cache->store(input, flags, headers, python);
+	}
+	PhaseScope phase(Phase::Emission);
+	out << python;
+	return isTranslated;
+}
+
+bool translateStdin(OutputSink& out, TranslationSession& session) {
+	auto input = llvm::MemoryBuffer::getSTDIN();
+	if (!input) {
+		llvm::errs() << "cannot read stdin: " << input.getError().message() << "\n";
+		return false;
+	}
+
+	// buffer is mapped as virtual file without copying, it lives until tool finishes
+	auto name = (fs::current_path() / "stdin.cpp").string();
+	auto database = getDefaultDatabase();
+	clang::tooling::ClangTool tool(database, { name },
+		std::make_shared<clang::PCHContainerOperations>(), createCachingFileSystem(session.files));
+	tool.mapVirtualFile(name, (*input)->getBuffer());
+
+	TranslationActionFactory factory(out, nullptr, session.modules);
+	return tool.run(&factory) == 0;
+}
+
+std::vector<BatchItem> collectBatchItems(const std::vector<std::string>& paths, const std::string& outputDir, std::string& error) {
+	std::vector<BatchItem> items;
+	for (const auto& p : paths) {
+		fs::path root(p);
+		if (fs::is_directory(root)) {
+			for (const auto& entry : fs::recursive_directory_iterator(root)) {
+				if (entry.is_regular_file() && isSourceFile(entry.path())) {
+					auto output = getOutputPath(entry.path(), fs::relative(entry.path(), root), outputDir);
+					items.push_back({ fs::absolute(entry.path()).string(), output.string() });
+				}
+			}
+		}
+		else {
+			// keep directory structure for files under current directory (sources from compilation database),
+			// files outside of it keep their absolute directories, so equal names do not overwrite each other
+			auto relative = fs::relative(root);
+			if (relative.empty() || *relative.begin() == "..") {
+				relative = fs::absolute(root).relative_path();
+			}
+			auto output = getOutputPath(root, relative, outputDir);
+			items.push_back({ fs::absolute(root).string(), output.string() });
+		}
+	}
+
+	// the same file given twice is translated once, different sources must not share output
+	std::map<std::string, std::string> sources;
+	std::vector<BatchItem> unique;
+	for (auto& item : items) {
+		auto key = fs::absolute(item.output).lexically_normal().string();
+		auto [it, isNew] = sources.try_emplace(key, item.input);
+		if (isNew) {
+			unique.push_back(std::move(item));
+		}
+		else if (it->second != item.input) {
+			error = it->second + " and " + item.input + " are both translated to " + item.output;
+			return {};
+		}
+	}
+	return unique;
+}
+
+size_t runBatch(const std::vector<BatchItem>& items, unsigned jobs, TranslationSession& session) {
+	// start from the largest files, so the last busy worker does not hold whole run
+	std::vector<std::pair<uintmax_t, const BatchItem*>> queue;
+	for (const auto& item : items) {
+		std::error_code ec;
+		auto size = fs::file_size(item.input, ec);
+		queue.push_back({ ec ? 0 : size, &item });
+	}
+	std::stable_sort(queue.begin(), queue.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	std::atomic<size_t> failed{ 0 };
+	llvm::ThreadPool pool(llvm::hardware_concurrency(jobs));
+	for (const auto& [size, item] : queue) {
+		pool.async([item = item, &session, &failed] {
+			std::error_code ec;
+			fs::create_directories(fs::path(item->output).parent_path(), ec);
+
+			auto out = openFileSink(item->output, ec);
+			bool isTranslated = out && translateFile(item->input, *out, session);
+			if (out && !closeFileSink(*out, item->output)) {
+				isTranslated = false;
+			}
+			if (!isTranslated) {
+				llvm::errs() << "cannot translate " << item->input << "\n";
+				failed++;
+			}
+		});
+	}
+	pool.wait();
+	return failed;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "OutputSink.h"
+#include "CachingFileSystem.h"
+
+namespace clang {
+namespace tooling {
+class CompilationDatabase;
+}
+}
+class TranslationCache;
+class PreambleCache;
+class HeaderModuleRegistry;
+
+// c++ source and python file generated for it
+struct BatchItem {
+	std::string input;
+	std::string output;
+};
+
+// state shared by all files of one run
+struct TranslationSession {
+	// with compilation database files are parsed with their compile commands through ClangTool
+	const clang::tooling::CompilationDatabase* compilations = nullptr;
+	// translated files from previous runs
+	TranslationCache* cache = nullptr;
+	// precompiled headers shared by files with the same #include block (compilation database only)
+	PreambleCache* preambles = nullptr;
+	// modules of headers written during run (--header-modules)
+	HeaderModuleRegistry* modules = nullptr;
+	// stats and headers read by all workers
+	SharedFileSystemCache files;
+	// unsaved editor buffers placed over disk files (resident server). Files are not cached with them
+	llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> unsaved;
+};
+
+// translate one c++ file and write python code to given sink
+bool translateFile(const std::string& input, OutputSink& out, TranslationSession& session);
+
+// translate c++ code read from standard input. Compilation database is not used for it
+bool translateStdin(OutputSink& out, TranslationSession& session);
+
+// expand given files and directories to c++ sources. Python files are placed to outputDir
+// keeping directory structure (or next to sources if outputDir is empty).
+// Sources which would be written to the same python file are reported in error, result is empty then
+std::vector<BatchItem> collectBatchItems(const std::vector<std::string>& paths, const std::string& outputDir, std::string& error);
+
+// translate items on pool of 'jobs' threads (0 = all cores). Returns number of failed items
+size_t runBatch(const std::vector<BatchItem>& items, unsigned jobs, TranslationSession& session);
@@ -0,0 +1,155 @@
+#include "CachingFileSystem.h"
+#include "llvm/Support/DJB.h"
+#include "llvm/Support/Path.h"
+
+SharedFileSystemCache::Shard& SharedFileSystemCache::getShard(llvm::StringRef path) {
+	return shards[llvm::djbHash(path) % shards.size()];
+}
+
+SharedFileSystemCache::StatusResult SharedFileSystemCache::getStatus(llvm::StringRef path, const std::function<StatusResult()>& load) {
+	auto& shard = getShard(path);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.statuses.find(path);
+		if (it != shard.statuses.end()) {
+			return it->second;
+		}
+	}
+
+	// stat outside of lock, concurrent workers may do it twice but do not wait for each other
+	auto status = load();
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	return shard.statuses.try_emplace(path, status).first->second;
+}
+
+llvm::ErrorOr<SharedFileSystemCache::Buffer> SharedFileSystemCache::getBuffer(llvm::StringRef path, const std::function<llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>()>& load) {
+	auto& shard = getShard(path);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.buffers.find(path);
+		if (it != shard.buffers.end()) {
+			return it->second;
+		}
+	}
+
+	auto buffer = load();
+	if (!buffer) {
+		return buffer.getError();
+	}
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	return shard.buffers.try_emplace(path, Buffer(std::move(*buffer))).first->second;
+}
+
+static bool isSameFile(const SharedFileSystemCache::StatusResult& cached, const SharedFileSystemCache::StatusResult& actual) {
+	if (!cached || !actual) {
+		return !cached && !actual;
+	}
+	return cached->getType() == actual->getType() && cached->getSize() == actual->getSize()
+		&& cached->getLastModificationTime() == actual->getLastModificationTime();
+}
+
+size_t SharedFileSystemCache::refresh(llvm::vfs::FileSystem& fs) {
+	size_t dropped = 0;
+	for (auto& shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		std::vector<std::string> changed;
+		for (const auto& entry : shard.statuses) {
+			if (!isSameFile(entry.second, fs.status(entry.first()))) {
+				changed.push_back(entry.first().str());
+			}
+		}
+		for (const auto& path : changed) {
+			shard.statuses.erase(path);
+			shard.buffers.erase(path);
+		}
+		dropped += changed.size();
+	}
+	return dropped;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// opened file which content lives in shared cache
+class CachedFile : public llvm::vfs::File {
+public:
+	CachedFile(llvm::vfs::Status status, SharedFileSystemCache::Buffer buffer)
+		: fileStatus(std::move(status)), buffer(std::move(buffer)) {}
+
+	llvm::ErrorOr<llvm::vfs::Status> status() override {
+		return fileStatus;
+	}
+
+	llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(const llvm::Twine& /*Name*/, int64_t /*FileSize*/,
+		bool RequiresNullTerminator, bool /*IsVolatile*/) override {
+		// buffers are always loaded null terminated, so reference is enough
+		return llvm::MemoryBuffer::getMemBuffer(buffer->getMemBufferRef(), RequiresNullTerminator);
+	}
+
+	std::error_code close() override {
+		return {};
+	}
+private:
+	llvm::vfs::Status fileStatus;
+	SharedFileSystemCache::Buffer buffer;
+};
+
+}
+
+CachingFileSystem::CachingFileSystem(SharedFileSystemCache& cache, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+	: ProxyFileSystem(std::move(fs)), cache(cache) {}
+
+bool CachingFileSystem::getCacheKey(const llvm::Twine& Path, llvm::SmallVectorImpl<char>& key) {
+	Path.toVector(key);
+	if (makeAbsolute(key)) {
+		return false;
+	}
+	llvm::sys::path::remove_dots(key, true);
+	return true;
+}
+
+llvm::ErrorOr<llvm::vfs::Status> CachingFileSystem::status(const llvm::Twine& Path) {
+	llvm::SmallString<256> key;
+	if (!getCacheKey(Path, key)) {
+		return ProxyFileSystem::status(Path);
+	}
+
+	auto status = cache.getStatus(key, [&] { return ProxyFileSystem::status(key); });
+	if (!status) {
+		return status;
+	}
+	return llvm::vfs::Status::copyWithNewName(*status, Path.str());
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> CachingFileSystem::openFileForRead(const llvm::Twine& Path) {
+	llvm::SmallString<256> key;
+	if (!getCacheKey(Path, key)) {
+		return ProxyFileSystem::openFileForRead(Path);
+	}
+
+	auto status = this->status(Path);
+	if (!status) {
+		return status.getError();
+	}
+	if (!status->isRegularFile()) {
+		return ProxyFileSystem::openFileForRead(Path);
+	}
+
+	auto buffer = cache.getBuffer(key, [&]() -> llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> {
+		auto file = ProxyFileSystem::openFileForRead(key);
+		if (!file) {
+			return file.getError();
+		}
+		return (*file)->getBuffer(key, status->getSize());
+	});
+	if (!buffer) {
+		return buffer.getError();
+	}
+	return std::make_unique<CachedFile>(*status, *buffer);
+}
+
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> createCachingFileSystem(SharedFileSystemCache& cache) {
+	llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> physical(llvm::vfs::createPhysicalFileSystem().release());
+	return new CachingFileSystem(cache, physical);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// stat results and file contents shared by all workers of one run.
+// Every header is stat-ed and read once, negative lookups from include directories are cached too
+class SharedFileSystemCache {
+public:
+	typedef llvm::ErrorOr<llvm::vfs::Status> StatusResult;
+	typedef std::shared_ptr<llvm::MemoryBuffer> Buffer;
+
+	StatusResult getStatus(llvm::StringRef path, const std::function<StatusResult()>& load);
+	llvm::ErrorOr<Buffer> getBuffer(llvm::StringRef path, const std::function<llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>()>& load);
+	// stat cached paths again and drop files which were changed, created or removed since they were cached.
+	// Batch run sees the same files from start to end, resident server calls it before each request
+	size_t refresh(llvm::vfs::FileSystem& fs);
+private:
+	struct Shard {
+		std::mutex mutex;
+		llvm::StringMap<StatusResult> statuses;
+		llvm::StringMap<Buffer> buffers;
+	};
+	std::array<Shard, 32> shards;
+
+	Shard& getShard(llvm::StringRef path);
+};
+
+// file system of one worker. It has own working directory and takes stats and contents from shared cache
+class CachingFileSystem : public llvm::vfs::ProxyFileSystem {
+public:
+	CachingFileSystem(SharedFileSystemCache& cache, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs);
+
+	llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine& Path) override;
+	llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine& Path) override;
+private:
+	SharedFileSystemCache& cache;
+
+	bool getCacheKey(const llvm::Twine& Path, llvm::SmallVectorImpl<char>& key);
+};
+
+// worker file system over physical file system with private working directory
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> createCachingFileSystem(SharedFileSystemCache& cache);
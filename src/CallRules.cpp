@@ -0,0 +1,294 @@
+#include "CallRules.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SHA1.h"
+
+#include <cassert>
+
+namespace {
+
+// forms of common STL and cmath calls
+const char* defaultRules = R"json({
+	"std::sqrt": { "python": "math.sqrt({0})", "numpy": "np.sqrt({0})", "import": "import math" },
+	"std::exp": { "python": "math.exp({0})", "numpy": "np.exp({0})", "import": "import math" },
+	"std::log": { "python": "math.log({0})", "numpy": "np.log({0})", "import": "import math" },
+	"std::log10": { "python": "math.log10({0})", "numpy": "np.log10({0})", "import": "import math" },
+	"std::log2": { "python": "math.log2({0})", "numpy": "np.log2({0})", "import": "import math" },
+	"std::sin": { "python": "math.sin({0})", "numpy": "np.sin({0})", "import": "import math" },
+	"std::cos": { "python": "math.cos({0})", "numpy": "np.cos({0})", "import": "import math" },
+	"std::tan": { "python": "math.tan({0})", "numpy": "np.tan({0})", "import": "import math" },
+	"std::asin": { "python": "math.asin({0})", "numpy": "np.arcsin({0})", "import": "import math" },
+	"std::acos": { "python": "math.acos({0})", "numpy": "np.arccos({0})", "import": "import math" },
+	"std::atan": { "python": "math.atan({0})", "numpy": "np.arctan({0})", "import": "import math" },
+	"std::atan2": { "python": "math.atan2({0}, {1})", "numpy": "np.arctan2({0}, {1})", "import": "import math" },
+	"std::sinh": { "python": "math.sinh({0})", "numpy": "np.sinh({0})", "import": "import math" },
+	"std::cosh": { "python": "math.cosh({0})", "numpy": "np.cosh({0})", "import": "import math" },
+	"std::tanh": { "python": "math.tanh({0})", "numpy": "np.tanh({0})", "import": "import math" },
+	"std::floor": { "python": "math.floor({0})", "numpy": "np.floor({0})", "import": "import math" },
+	"std::ceil": { "python": "math.ceil({0})", "numpy": "np.ceil({0})", "import": "import math" },
+	"std::trunc": { "python": "math.trunc({0})", "numpy": "np.trunc({0})", "import": "import math" },
+	"std::fmod": { "python": "math.fmod({0}, {1})", "numpy": "np.fmod({0}, {1})", "import": "import math" },
+	"std::pow": { "python": "math.pow({0}, {1})", "numpy": "np.power({0}, {1})", "import": "import math" },
+	"std::hypot": { "python": "math.hypot({0}, {1})", "numpy": "np.hypot({0}, {1})", "import": "import math", "args": 2 },
+	"std::isnan": { "python": "math.isnan({0})", "numpy": "np.isnan({0})", "import": "import math" },
+	"std::fabs": { "python": "math.fabs({0})", "numpy": "np.abs({0})", "import": "import math" },
+	"std::abs": { "python": "abs({0})", "numpy": "np.abs({0})" },
+	"std::fmin": { "python": "min({0}, {1})", "numpy": "np.fmin({0}, {1})" },
+	"std::fmax": { "python": "max({0}, {1})", "numpy": "np.fmax({0}, {1})" },
+	"std::min": { "python": "min({0}, {1})", "numpy": "np.minimum({0}, {1})", "args": 2 },
+	"std::max": { "python": "max({0}, {1})", "numpy": "np.maximum({0}, {1})", "args": 2 },
+	"std::swap": { "python": "{0}, {1} = {1}, {0}", "args": 2 },
+
+	"std::accumulate": { "python": "sum({0:1}, {2})", "numpy": "np.sum({0:1}) + {2}", "args": 3 },
+	"std::sort": { "python": "{0:1:slice} = sorted({0:1})", "numpy": "{0:1}.sort()", "args": 2 },
+	"std::reverse": { "python": "{0:1:slice} = {0:1}[::-1]", "args": 2 },
+	"std::fill": { "python": "{0:1:slice} = [{2}] * len({0:1})", "numpy": "{0:1:slice} = {2}", "args": 3 },
+	"std::count": { "python": "{0:1}.count({2})", "numpy": "np.count_nonzero({0:1} == {2})", "args": 3 },
+	"*std::max_element": { "python": "max({0:1})", "numpy": "np.max({0:1})", "args": 2 },
+	"*std::min_element": { "python": "min({0:1})", "numpy": "np.min({0:1})", "args": 2 },
+	"std::max_element": { "python": "max(range(len({0:1})), key={0:1}.__getitem__)", "numpy": "np.argmax({0:1})", "args": 2, "index": true },
+	"std::min_element": { "python": "min(range(len({0:1})), key={0:1}.__getitem__)", "numpy": "np.argmin({0:1})", "args": 2, "index": true },
+
+	"std::vector::size": "len({self})",
+	"std::vector::empty": "len({self}) == 0",
+	"std::vector::push_back": "{self}.append({0})",
+	"std::vector::emplace_back": { "python": "{self}.append({0})", "args": 1 },
+	"std::vector::pop_back": "{self}.pop()",
+	"std::vector::back": "{self}[-1]",
+	"std::vector::front": "{self}[0]",
+	"std::vector::clear": "{self}.clear()",
+	"std::array::size": "len({self})",
+	"std::deque::size": "len({self})",
+	"std::deque::push_back": "{self}.append({0})",
+	"std::deque::push_front": "{self}.insert(0, {0})",
+	"std::basic_string::size": "len({self})",
+	"std::basic_string::length": "len({self})",
+	"std::basic_string::empty": "len({self}) == 0",
+	"std::map::size": "len({self})",
+	"std::map::count": "int({0} in {self})",
+	"std::unordered_map::size": "len({self})",
+	"std::unordered_map::count": "int({0} in {self})",
+	"std::set::size": "len({self})",
+	"std::set::insert": { "python": "{self}.add({0})", "args": 1 },
+	"std::set::count": "int({0} in {self})",
+	"std::unordered_set::size": "len({self})",
+	"std::unordered_set::insert": { "python": "{self}.add({0})", "args": 1 },
+	"std::unordered_set::count": "int({0} in {self})"
+})json";
+
+std::string fingerprint;
+
+bool parseRules(llvm::StringRef text, llvm::StringMap<CallRule>& rules, std::string& error) {
+	auto root = llvm::json::parse(text);
+	if (!root) {
+		error = llvm::toString(root.takeError());
+		return false;
+	}
+	const auto* object = root->getAsObject();
+	if (object == nullptr) {
+		error = "rules must be json object";
+		return false;
+	}
+
+	for (const auto& [key, value] : *object) {
+		CallRule rule;
+		if (auto form = value.getAsString()) {
+			rule.python = form->str();
+		}
+		else if (const auto* fields = value.getAsObject()) {
+			if (auto form = fields->getString("python")) rule.python = form->str();
+			if (auto form = fields->getString("numpy")) rule.numpy = form->str();
+			if (auto import = fields->getString("import")) rule.imports.push_back(import->str());
+			if (auto args = fields->getInteger("args")) rule.args = static_cast<int>(*args);
+			if (auto isIndex = fields->getBoolean("index")) rule.isIndex = *isIndex;
+		}
+		if (rule.python.empty()) {
+			error = "rule '" + key.str() + "' has no python form";
+			return false;
+		}
+		rules[key.str()] = std::move(rule);
+	}
+	return true;
+}
+
+// rules are extended by loadCallRules before translation and only read by workers
+llvm::StringMap<CallRule>& getRules() {
+	static llvm::StringMap<CallRule> rules = [] {
+		llvm::StringMap<CallRule> defaults;
+		std::string error;
+		bool isParsed = parseRules(defaultRules, defaults, error);
+		assert(isParsed && "embedded rule table is invalid");
+		(void)isParsed;
+		return defaults;
+	}();
+	return rules;
+}
+
+}
+
+bool loadCallRules(const std::string& path, std::string& error) {
+	if (path.empty()) {
+		return true;
+	}
+
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		error = path + ": " + buffer.getError().message();
+		return false;
+	}
+	if (!parseRules((*buffer)->getBuffer(), getRules(), error)) {
+		error = path + ": " + error;
+		return false;
+	}
+
+	llvm::SHA1 hasher;
+	hasher.update((*buffer)->getBuffer());
+	fingerprint = llvm::toHex(hasher.final(), true);
+	return true;
+}
+
+std::string getCallRulesFingerprint() {
+	return fingerprint;
+}
+
+std::string getCallRuleKey(const FunctionDecl* F) {
+	std::string key = F->getNameAsString();
+	for (const auto* context = F->getDeclContext(); context != nullptr; context = context->getParent()) {
+		if (const auto* ns = dyn_cast<NamespaceDecl>(context)) {
+			// std::__1, std::__cxx11
+			if (ns->isInline() || ns->isAnonymousNamespace()) continue;
+			key = ns->getName().str() + "::" + key;
+		}
+		else if (const auto* record = dyn_cast<RecordDecl>(context)) {
+			// name of specialization is name of its template
+			key = record->getName().str() + "::" + key;
+		}
+		else if (isa<TranslationUnitDecl>(context)) {
+			break;
+		}
+		else if (!isa<LinkageSpecDecl>(context)) {
+			// local class or function
+			return std::string();
+		}
+	}
+
+	if (F->isExternC() && key.find("::") == std::string::npos) {
+		key = "std::" + key;
+	}
+	return key;
+}
+
+static const CallRule* findRule(const FunctionDecl* F, unsigned numArgs, bool isDereferenced) {
+	if (F == nullptr || F->getIdentifier() == nullptr) {
+		return nullptr;
+	}
+	auto key = getCallRuleKey(F);
+	if (key.empty()) {
+		return nullptr;
+	}
+	const auto& rules = getRules();
+	auto it = rules.find(isDereferenced ? "*" + key : key);
+	if (it == rules.end() || (it->second.args >= 0 && static_cast<unsigned>(it->second.args) != numArgs)) {
+		return nullptr;
+	}
+	return &it->second;
+}
+
+const CallRule* findCallRule(const FunctionDecl* F, unsigned numArgs, bool isDereferenced) {
+	const auto* rule = findRule(F, numArgs, isDereferenced);
+	// index is not an iterator, it can be printed only where iterator is turned to index
+	return rule != nullptr && !rule->isIndex ? rule : nullptr;
+}
+
+const CallRule* findIndexRule(const FunctionDecl* F, unsigned numArgs) {
+	const auto* rule = findRule(F, numArgs, false);
+	return rule != nullptr && rule->isIndex ? rule : nullptr;
+}
+
+std::optional<std::string> expandRuleForm(llvm::StringRef form,
+	llvm::function_ref<std::optional<std::string>(const RulePlaceholder&)> getText) {
+	std::string text;
+	size_t pos = 0;
+	while (pos < form.size()) {
+		auto open = form.find('{', pos);
+		auto close = open != llvm::StringRef::npos ? form.find('}', open) : llvm::StringRef::npos;
+		if (close == llvm::StringRef::npos) {
+			text += form.substr(pos).str();
+			break;
+		}
+		text += form.substr(pos, open - pos).str();
+
+		// {self}, {0}, {0:1}, {0:1:slice}
+		RulePlaceholder placeholder;
+		auto name = form.substr(open + 1, close - open - 1);
+		llvm::SmallVector<llvm::StringRef, 3> parts;
+		name.split(parts, ':');
+		if (name == "self") {
+			placeholder.kind = RulePlaceholder::Object;
+		}
+		else if (parts.size() == 1 && !parts[0].getAsInteger(10, placeholder.first)) {
+			placeholder.kind = RulePlaceholder::Argument;
+		}
+		else if ((parts.size() == 2 || (parts.size() == 3 && parts[2] == "slice"))
+			&& !parts[0].getAsInteger(10, placeholder.first) && !parts[1].getAsInteger(10, placeholder.last)) {
+			placeholder.kind = parts.size() == 3 ? RulePlaceholder::Slice : RulePlaceholder::Sequence;
+		}
+		else {
+			return std::nullopt;
+		}
+
+		char before = open > 0 ? form[open - 1] : '\0';
+		char after = close + 1 < form.size() ? form[close + 1] : '\0';
+		bool isAfterComma = before == ' ' && open > 1 && form[open - 2] == ',';
+		placeholder.isDelimited = (before == '(' || before == '[' || isAfterComma) && (after == ')' || after == ']' || after == ',');
+
+		auto replacement = getText(placeholder);
+		if (!replacement) {
+			return std::nullopt;
+		}
+		text += *replacement;
+		pos = close + 1;
+	}
+	return text;
+}
+
+namespace {
+
+class RuleImportCollector : public RecursiveASTVisitor<RuleImportCollector> {
+public:
+	explicit RuleImportCollector(std::vector<std::string>& imports)
+		: imports(imports) {}
+
+	bool VisitCallExpr(CallExpr* C) {
+		const auto* F = C->getDirectCallee();
+		auto numArgs = C->getNumArgs();
+		// kind of rule depends on how result of call is used, imports of all of them are taken
+		for (const auto* rule : { findCallRule(F, numArgs), findCallRule(F, numArgs, true), findIndexRule(F, numArgs) }) {
+			if (rule == nullptr) continue;
+			for (const auto& i : rule->imports) {
+				if (seen.insert(i).second) imports.push_back(i);
+			}
+		}
+		return true;
+	}
+private:
+	std::vector<std::string>& imports;
+	llvm::StringSet<> seen;
+};
+
+}
+
+std::vector<std::string> collectRuleImports(llvm::ArrayRef<const Decl*> decls) {
+	std::vector<std::string> imports;
+	RuleImportCollector collector(imports);
+	for (const auto* d : decls) {
+		collector.TraverseDecl(const_cast<Decl*>(d));
+	}
+	return imports;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "clang/AST/Decl.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+// translation of library call to python builtin or numpy function. Forms are python text with placeholders:
+// {0}, {1}.. arguments, {self} object of method call, {0:1} sequence given by iterator arguments 0 and 1
+// ('v' or 'v[a:b]'), {0:1:slice} the same sequence as assignment target ('v[:]' or 'v[a:b]')
+struct CallRule {
+	std::string python;
+	// used when an argument is numpy array, python form is used if empty
+	std::string numpy;
+	// imports needed by python form, numpy form needs only numpy
+	std::vector<std::string> imports;
+	// required number of arguments, rule does not apply to other overloads. -1 for any
+	int args = -1;
+	// result is index in sequence instead of iterator ('it - v.begin()' is printed as call)
+	bool isIndex = false;
+};
+
+struct RulePlaceholder {
+	enum Kind { Argument, Object, Sequence, Slice };
+	Kind kind = Argument;
+	unsigned first = 0;
+	unsigned last = 0;
+	// placeholder is whole argument of call or subscript, so it needs no parentheses
+	bool isDelimited = false;
+};
+
+// rules are loaded once before translation: embedded table overridden by rules of json file
+// { "std::sqrt": { "python": "math.sqrt({0})", "numpy": "np.sqrt({0})", "import": "import math" },
+//   "std::vector::size": "len({self})" }.
+// Returns false and sets error if file cannot be read or parsed
+bool loadCallRules(const std::string& path, std::string& error);
+// hash of loaded rule file, part of translation cache key
+std::string getCallRulesFingerprint();
+
+// qualified name of callee without inline namespaces and template arguments: 'std::sqrt', 'std::map::find'.
+// Functions of C library are in std namespace. Key of dereferenced call result is prefixed by '*'
+std::string getCallRuleKey(const FunctionDecl* F);
+// rule of call with given number of arguments, nullptr if call is translated verbatim.
+// Index rules are not returned, their result is not the iterator which call returns
+const CallRule* findCallRule(const FunctionDecl* F, unsigned numArgs, bool isDereferenced = false);
+// index rule of call, for distance 'call(...) - v.begin()' only
+const CallRule* findIndexRule(const FunctionDecl* F, unsigned numArgs);
+
+// form with replaced placeholders, nullopt if getText fails for any of them
+std::optional<std::string> expandRuleForm(llvm::StringRef form,
+	llvm::function_ref<std::optional<std::string>(const RulePlaceholder&)> getText);
+// imports of rules which calls inside of declarations may use, in order of first call. Taken before
+// translation, so module header is written before declarations which are streamed after it
+std::vector<std::string> collectRuleImports(llvm::ArrayRef<const Decl*> decls);
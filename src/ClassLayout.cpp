@@ -0,0 +1,85 @@
+#include "ClassLayout.h"
+#include "TranslationContext.h"
+#include "TranslationOptions.h"
+
+#include "clang/AST/Attr.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <algorithm>
+
+static llvm::DenseSet<const CXXRecordDecl*>& getDictClasses() {
+	static thread_local llvm::DenseSet<const CXXRecordDecl*> classes;
+	return classes;
+}
+
+static bool hasFieldsInHierarchy(const CXXRecordDecl* R) {
+	R = R != nullptr ? R->getDefinition() : nullptr;
+	if (R == nullptr) {
+		return false;
+	}
+	if (!R->field_empty()) {
+		return true;
+	}
+	return std::any_of(R->bases_begin(), R->bases_end(), [](const CXXBaseSpecifier& b) {
+		return hasFieldsInHierarchy(b.getType()->getAsCXXRecordDecl());
+	});
+}
+
+static void markHierarchy(const CXXRecordDecl* R, llvm::DenseSet<const CXXRecordDecl*>& classes) {
+	R = R != nullptr ? R->getDefinition() : nullptr;
+	if (R == nullptr || !classes.insert(R->getCanonicalDecl()).second) {
+		return;
+	}
+	for (const auto& b : R->bases()) {
+		markHierarchy(b.getType()->getAsCXXRecordDecl(), classes);
+	}
+}
+
+void scanClassLayouts(const TranslationUnitDecl* Unit) {
+	auto& classes = getDictClasses();
+	classes.clear();
+
+	for (const auto* d : Unit->decls()) {
+		const auto* R = dyn_cast<CXXRecordDecl>(d);
+		if (R == nullptr || !R->isThisDeclarationADefinition() || R->getNumBases() < 2) continue;
+
+		size_t layouts = 0;
+		for (const auto& b : R->bases()) {
+			layouts += hasFieldsInHierarchy(b.getType()->getAsCXXRecordDecl()) ? 1 : 0;
+		}
+		if (layouts < 2) continue;
+
+		for (const auto& b : R->bases()) {
+			markHierarchy(b.getType()->getAsCXXRecordDecl(), classes);
+		}
+	}
+}
+
+bool canUseSlots(const CXXRecordDecl* R) {
+	const auto& options = getTranslationOptions();
+	// cdef classes have fixed layout anyway
+	if (!options.slots || options.backend == Backend::Cython) {
+		return false;
+	}
+
+	for (const auto* attr : R->specific_attrs<AnnotateAttr>()) {
+		if (attr->getAnnotation() == "cpp2python:dynamic") {
+			return false;
+		}
+	}
+	// class of header module may be a base in other units, which are not scanned with this one
+	if (options.headerModules && !R->hasAttr<FinalAttr>()) {
+		const auto& SM = R->getASTContext().getSourceManager();
+		auto lock = lockASTContext();
+		if (!SM.isInMainFile(SM.getExpansionLoc(R->getLocation()))) {
+			return false;
+		}
+	}
+
+	const auto& names = options.dynamicClasses;
+	if (std::find(names.begin(), names.end(), R->getNameAsString()) != names.end()
+		|| std::find(names.begin(), names.end(), R->getQualifiedNameAsString()) != names.end()) {
+		return false;
+	}
+	return getDictClasses().count(R->getCanonicalDecl()) == 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "clang/AST/DeclCXX.h"
+
+using namespace clang;
+
+// classes of TU which cannot have __slots__: python forbids several bases with non-empty
+// slot layouts, so with multiple inheritance of classes with fields every class of those
+// hierarchies keeps __dict__. Must be called before declarations are translated
+void scanClassLayouts(const TranslationUnitDecl* Unit);
+
+// class is emitted with __slots__ built from its own fields. With --header-modules classes of
+// headers keep __dict__ unless they are final. Opt-out: --no-slots,
+// --dynamic-class=<name> or __attribute__((annotate("cpp2python:dynamic")))
+bool canUseSlots(const CXXRecordDecl* R);
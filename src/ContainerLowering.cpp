@@ -0,0 +1,428 @@
+#include "ContainerLowering.h"
+#include "ExpressionProcessor.h"
+#include "LoopAnalysis.h"
+#include "TranslationOptions.h"
+#include "TypeMapper.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+enum class ContainerKind {
+	None,
+	Vector,
+	StdArray,
+	CArray
+};
+
+struct ContainerType {
+	ContainerKind kind = ContainerKind::None;
+	QualType element;
+	uint64_t size = 0;
+};
+
+ContainerType getContainerType(QualType type) {
+	type = type.getCanonicalType();
+	if (const auto* array = dyn_cast<ConstantArrayType>(type.getTypePtr())) {
+		return { ContainerKind::CArray, array->getElementType(), array->getSize().getZExtValue() };
+	}
+
+	const auto* record = dyn_cast_or_null<ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+	if (record == nullptr || !record->isInStdNamespace()) {
+		return {};
+	}
+	const auto& args = record->getTemplateArgs();
+	if (args.size() == 0 || args[0].getKind() != TemplateArgument::Type) {
+		return {};
+	}
+	if (record->getName() == "vector") {
+		return { ContainerKind::Vector, args[0].getAsType(), 0 };
+	}
+	if (record->getName() == "array" && args.size() > 1 && args[1].getKind() == TemplateArgument::Integral) {
+		return { ContainerKind::StdArray, args[0].getAsType(), args[1].getAsIntegral().getZExtValue() };
+	}
+	return {};
+}
+
+bool isReferenceTo(const Expr* E, const VarDecl* D) {
+	const auto* ref = E != nullptr ? dyn_cast<DeclRefExpr>(E->IgnoreParenImpCasts()) : nullptr;
+	return ref != nullptr && ref->getDecl() == D;
+}
+
+llvm::StringRef getMethodName(const CXXMemberCallExpr* C) {
+	const auto* method = C->getMethodDecl();
+	return method != nullptr && method->getIdentifier() != nullptr ? method->getName() : llvm::StringRef();
+}
+
+// methods which change size of vector, numpy array cannot do it in place
+bool isGrowingMethod(llvm::StringRef name) {
+	static const llvm::StringSet<> methods = {
+		"push_back", "emplace_back", "pop_back", "insert", "emplace", "erase", "clear", "assign", "swap",
+	};
+	return methods.count(name) != 0;
+}
+
+struct ContainerUses {
+	std::vector<const CXXMemberCallExpr*> growing;
+	// container may be changed where it cannot be seen: reassigned, bound to reference, passed to unknown code
+	bool isEscaped = false;
+	size_t references = 0;
+};
+
+void collectUses(const Stmt* S, const VarDecl* D, ContainerUses& uses) {
+	if (S == nullptr) {
+		return;
+	}
+
+	if (isReferenceTo(dyn_cast<Expr>(S), D) && isa<DeclRefExpr>(S)) {
+		uses.references++;
+	}
+	if (const auto* call = dyn_cast<CXXMemberCallExpr>(S)) {
+		if (isReferenceTo(call->getImplicitObjectArgument(), D) && isGrowingMethod(getMethodName(call))) {
+			uses.growing.push_back(call);
+		}
+	}
+	else if (const auto* op = dyn_cast<CXXOperatorCallExpr>(S)) {
+		if (op->getOperator() == OO_Equal && isReferenceTo(op->getArg(0), D)) {
+			uses.isEscaped = true;
+		}
+	}
+	else if (const auto* call = dyn_cast<CallExpr>(S)) {
+		const auto* f = call->getDirectCallee();
+		for (unsigned i = 0; i < call->getNumArgs(); i++) {
+			if (!isReferenceTo(call->getArg(i), D)) continue;
+
+			// callee with non-const reference parameter may grow container
+			if (f == nullptr || i >= f->getNumParams()) {
+				uses.isEscaped = true;
+				continue;
+			}
+			auto type = f->getParamDecl(i)->getType();
+			if (type->isReferenceType() && !type.getNonReferenceType().isConstQualified()) {
+				uses.isEscaped = true;
+			}
+		}
+	}
+	else if (const auto* decl = dyn_cast<DeclStmt>(S)) {
+		for (const auto* d : decl->decls()) {
+			const auto* vd = dyn_cast<VarDecl>(d);
+			if (vd != nullptr && vd->getType()->isReferenceType() && isReferenceTo(vd->getInit(), D)) {
+				uses.isEscaped = true;
+			}
+		}
+	}
+
+	for (const auto* child : S->children()) {
+		collectUses(child, D, uses);
+	}
+}
+
+// block with declaration of variable and position of declaration in it
+const CompoundStmt* findDeclaringBlock(const Stmt* S, const VarDecl* D, size_t& index) {
+	if (S == nullptr) {
+		return nullptr;
+	}
+	if (const auto* block = dyn_cast<CompoundStmt>(S)) {
+		size_t i = 0;
+		for (const auto* s : block->body()) {
+			const auto* decl = dyn_cast<DeclStmt>(s);
+			if (decl != nullptr && std::find(decl->decl_begin(), decl->decl_end(), D) != decl->decl_end()) {
+				index = i;
+				return block;
+			}
+			i++;
+		}
+	}
+	for (const auto* child : S->children()) {
+		if (const auto* block = findDeclaringBlock(child, D, index)) {
+			return block;
+		}
+	}
+	return nullptr;
+}
+
+bool isStatement(const Stmt* S, const Expr* E) {
+	const auto* expr = dyn_cast_or_null<Expr>(S);
+	return expr != nullptr && expr->IgnoreImplicit() == E;
+}
+
+// statement which leaves iteration of enclosing loop. Continue skips only statements after it,
+// so it is allowed after push_back. Break and continue of nested loops and break of switch stay inside
+bool hasJump(const Stmt* S, bool isContinueAllowed, bool isBreakInner = false, bool isContinueInner = false) {
+	if (S == nullptr || isa<LambdaExpr>(S)) {
+		return false;
+	}
+	if (isa<ReturnStmt>(S) || isa<GotoStmt>(S) || isa<IndirectGotoStmt>(S)) {
+		return true;
+	}
+	if (isa<BreakStmt>(S)) {
+		return !isBreakInner;
+	}
+	if (isa<ContinueStmt>(S)) {
+		return !isContinueInner && !isContinueAllowed;
+	}
+
+	if (isa<ForStmt>(S) || isa<WhileStmt>(S) || isa<DoStmt>(S) || isa<CXXForRangeStmt>(S)) {
+		isBreakInner = isContinueInner = true;
+	}
+	else if (isa<SwitchStmt>(S)) {
+		isBreakInner = true;
+	}
+	for (const auto* child : S->children()) {
+		if (hasJump(child, isContinueAllowed, isBreakInner, isContinueInner)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// 'std::vector<T> v; v.reserve(n); for (...) { ...; v.push_back(x); ... }'
+// push_back is top-level statement of loop body, every iteration reaches it and loop runs
+// to its end, so vector gets exactly one element per iteration. Loop does not use vector otherwise.
+// Loop counts up by one, so element is stored by its index in preallocated array
+const ForStmt* findFillLoop(const VarDecl* D, const CXXMemberCallExpr* fill) {
+	const auto* function = dyn_cast_or_null<FunctionDecl>(D->getParentFunctionOrMethod());
+	size_t index = 0;
+	const auto* block = function != nullptr ? findDeclaringBlock(function->getBody(), D, index) : nullptr;
+	if (block == nullptr) {
+		return nullptr;
+	}
+
+	auto it = block->body_begin() + index + 1;
+	while (it != block->body_end()) {
+		const auto* e = dyn_cast<Expr>(*it);
+		const auto* call = e != nullptr ? dyn_cast<CXXMemberCallExpr>(e->IgnoreImplicit()) : nullptr;
+		if (call == nullptr || !isReferenceTo(call->getImplicitObjectArgument(), D) || getMethodName(call) != "reserve") break;
+		++it;
+	}
+	const auto* loop = it != block->body_end() ? dyn_cast<ForStmt>(*it) : nullptr;
+	if (loop == nullptr || loop->getBody() == nullptr) {
+		return nullptr;
+	}
+	// array grown by np.append is copied on every push_back, python list is faster
+	auto counted = analyzeCountedLoop(loop);
+	if (!counted || !counted->isAscendingByOne()) {
+		return nullptr;
+	}
+
+	const auto* body = loop->getBody();
+	bool isUnconditional = isStatement(body, fill);
+	if (const auto* compound = dyn_cast<CompoundStmt>(body)) {
+		for (const auto* s : compound->body()) {
+			if (isStatement(s, fill)) {
+				isUnconditional = true;
+			}
+			else if (hasJump(s, isUnconditional)) {
+				return nullptr;
+			}
+		}
+	}
+
+	ContainerUses uses;
+	collectUses(loop, D, uses);
+	return isUnconditional && uses.references == 1 ? loop : nullptr;
+}
+
+std::string getElementText(const Expr* E) {
+	// value initialized element of aggregate
+	if (isa<ImplicitValueInitExpr>(E)) {
+		return "0";
+	}
+	return processExpr(E);
+}
+
+// np.array of aggregate initializer, missing elements are zeros
+std::optional<std::string> lowerInitList(const InitListExpr* L, uint64_t size, const std::string& dtype) {
+	// std::array<T, N> a = {{...}} or with elided braces
+	if (L->getNumInits() == 1) {
+		if (const auto* inner = dyn_cast<InitListExpr>(L->getInit(0)->IgnoreImplicit())) {
+			L = inner;
+		}
+	}
+	if (L->getNumInits() == 0) {
+		return "np.zeros(" + std::to_string(size) + ", dtype=" + dtype + ")";
+	}
+
+	std::string text = "np.array([";
+	for (unsigned i = 0; i < L->getNumInits(); i++) {
+		text += (i > 0 ? ", " : "") + getElementText(L->getInit(i));
+	}
+	text += "]";
+	if (L->getNumInits() < size) {
+		text += " + [0] * " + std::to_string(size - L->getNumInits());
+	}
+	return text + ", dtype=" + dtype + ")";
+}
+
+std::optional<std::string> lowerVectorInit(const Expr* init, QualType type, const std::string& dtype) {
+	if (init == nullptr) {
+		return "np.zeros(0, dtype=" + dtype + ")";
+	}
+	const auto* construct = dyn_cast<CXXConstructExpr>(init->IgnoreImplicit());
+	if (construct == nullptr) {
+		return std::nullopt;
+	}
+
+	std::vector<const Expr*> args;
+	for (const auto* a : construct->arguments()) {
+		if (!a->isDefaultArgument()) args.push_back(a->IgnoreImplicit());
+	}
+
+	if (args.empty()) {
+		return "np.zeros(0, dtype=" + dtype + ")";
+	}
+	if (args.size() == 1 && isa<CXXStdInitializerListExpr>(args[0])) {
+		return "np.array(" + processExpr(args[0]) + ", dtype=" + dtype + ")";
+	}
+	if (args.size() == 1 && args[0]->getType()->isIntegerType()) {
+		return "np.zeros(" + processExpr(args[0]) + ", dtype=" + dtype + ")";
+	}
+	if (args.size() == 1 && args[0]->getType().getCanonicalType().getUnqualifiedType() == type.getCanonicalType().getUnqualifiedType()) {
+		// copy
+		return "np.array(" + processExpr(args[0]) + ", dtype=" + dtype + ")";
+	}
+	if (args.size() == 2 && args[0]->getType()->isIntegerType() && args[1]->getType()->isArithmeticType()) {
+		return "np.full(" + processExpr(args[0]) + ", " + processExpr(args[1]) + ", dtype=" + dtype + ")";
+	}
+	// iterators, allocators, ...
+	return std::nullopt;
+}
+
+std::optional<std::string> lowerFixedInit(const Expr* init, uint64_t size, const std::string& dtype) {
+	if (init != nullptr) {
+		init = init->IgnoreImplicit();
+		if (const auto* list = dyn_cast<InitListExpr>(init)) {
+			return lowerInitList(list, size, dtype);
+		}
+		const auto* construct = dyn_cast<CXXConstructExpr>(init);
+		if (construct == nullptr || construct->getNumArgs() != 0) {
+			return std::nullopt;
+		}
+	}
+	return "np.zeros(" + std::to_string(size) + ", dtype=" + dtype + ")";
+}
+
+std::unique_ptr<NumpyContainer> analyzeContainer(const VarDecl* D) {
+	if (!D->isLocalVarDecl() || D->isStaticLocal()) {
+		return nullptr;
+	}
+	auto type = getContainerType(D->getType());
+	if (type.kind == ContainerKind::None || !type.element->isArithmeticType()) {
+		return nullptr;
+	}
+	auto dtype = getNumpyDtype(type.element, D->getASTContext());
+	if (!dtype) {
+		return nullptr;
+	}
+
+	auto container = std::make_unique<NumpyContainer>();
+	container->var = D;
+	container->dtype = *dtype;
+
+	if (type.kind == ContainerKind::Vector) {
+		const auto* function = dyn_cast_or_null<FunctionDecl>(D->getParentFunctionOrMethod());
+		ContainerUses uses;
+		collectUses(function != nullptr ? function->getBody() : nullptr, D, uses);
+		if (uses.isEscaped || uses.growing.size() > 1) {
+			return nullptr;
+		}
+		if (uses.growing.size() == 1) {
+			// the only growth is push_back of fill loop
+			const auto* fill = uses.growing.front();
+			auto name = getMethodName(fill);
+			if ((name != "push_back" && name != "emplace_back") || fill->getNumArgs() != 1) {
+				return nullptr;
+			}
+			container->fillLoop = findFillLoop(D, fill);
+			container->fill = fill;
+			if (container->fillLoop == nullptr) {
+				return nullptr;
+			}
+		}
+
+		// vector filled by loop starts empty
+		auto init = lowerVectorInit(D->getInit(), D->getType(), *dtype);
+		if (!init || (container->fillLoop != nullptr && *init != "np.zeros(0, dtype=" + *dtype + ")")) {
+			return nullptr;
+		}
+		return container;
+	}
+
+	if (!lowerFixedInit(D->getInit(), type.size, *dtype)) {
+		return nullptr;
+	}
+	return container;
+}
+
+typedef llvm::DenseMap<const VarDecl*, std::unique_ptr<NumpyContainer>> ContainerMap;
+
+ContainerMap& getContainers() {
+	static thread_local ContainerMap containers;
+	return containers;
+}
+
+}
+
+NumpyContainer* getNumpyContainer(const VarDecl* D) {
+	if (D == nullptr || !getTranslationOptions().numpyArrays) {
+		return nullptr;
+	}
+
+	auto& containers = getContainers();
+	auto it = containers.find(D);
+	if (it == containers.end()) {
+		it = containers.try_emplace(D, analyzeContainer(D)).first;
+	}
+	return it->second.get();
+}
+
+NumpyContainer* getNumpyContainer(const Expr* E) {
+	const auto* ref = E != nullptr ? dyn_cast<DeclRefExpr>(E->IgnoreParenImpCasts()) : nullptr;
+	return ref != nullptr ? getNumpyContainer(dyn_cast<VarDecl>(ref->getDecl())) : nullptr;
+}
+
+NumpyContainer* getFilledContainer(const ForStmt* Loop) {
+	if (!getTranslationOptions().numpyArrays || Loop->getBody() == nullptr) {
+		return nullptr;
+	}
+
+	std::vector<const Stmt*> statements{ Loop->getBody() };
+	if (const auto* compound = dyn_cast<CompoundStmt>(Loop->getBody())) {
+		statements.assign(compound->body_begin(), compound->body_end());
+	}
+	for (const auto* s : statements) {
+		const auto* e = dyn_cast<Expr>(s);
+		const auto* call = e != nullptr ? dyn_cast<CXXMemberCallExpr>(e->IgnoreImplicit()) : nullptr;
+		if (call == nullptr) continue;
+
+		auto* container = getNumpyContainer(call->getImplicitObjectArgument());
+		if (container != nullptr && container->fillLoop == Loop) {
+			return container;
+		}
+	}
+	return nullptr;
+}
+
+std::optional<std::string> lowerContainerInit(const VarDecl* D) {
+	const auto* container = getNumpyContainer(D);
+	if (container == nullptr) {
+		return std::nullopt;
+	}
+
+	auto type = getContainerType(D->getType());
+	if (type.kind == ContainerKind::Vector) {
+		return lowerVectorInit(D->getInit(), D->getType(), container->dtype);
+	}
+	return lowerFixedInit(D->getInit(), type.size, container->dtype);
+}
+
+void resetContainerAnalysis() {
+	getContainers().clear();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "clang/AST/Decl.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/Stmt.h"
+
+#include <optional>
+#include <string>
+
+using namespace clang;
+
+// local std::vector / std::array / c array of numbers which is emitted as numpy array
+// (--numpy-arrays). Vectors grown by push_back, insert, ... stay python lists, except
+// one push_back in ascending counted loop right after declaration: such loop preallocates array and fills it
+struct NumpyContainer {
+	const VarDecl* var = nullptr;
+	std::string dtype;
+	// counted loop which fills empty vector and its push_back
+	const ForStmt* fillLoop = nullptr;
+	const CXXMemberCallExpr* fill = nullptr;
+	// python index of pushed element, set while fill loop is translated
+	std::string fillIndex;
+};
+
+// null if variable is not lowered to numpy array
+NumpyContainer* getNumpyContainer(const VarDecl* D);
+// container referenced by expression (through implicit casts)
+NumpyContainer* getNumpyContainer(const Expr* E);
+// container which is filled by given loop
+NumpyContainer* getFilledContainer(const ForStmt* Loop);
+
+// np.zeros / np.full / np.array for declaration of lowered container
+std::optional<std::string> lowerContainerInit(const VarDecl* D);
+
+// analysis results are kept per thread, they are invalid for next translation unit
+void resetContainerAnalysis();
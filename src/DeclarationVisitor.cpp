@@ -1,231 +1,376 @@
-#include "DeclarationVisitor.h"
-#include "StatementVisitor.h"
-#include "ExpressionProcessor.h"
-#include "Lines.h"
-
-#include "clang/AST/Type.h"
-
-DeclarationVisitor::DeclarationVisitor(const Decl* Node) {
-	Visit(Node);
-}
-
-std::list<std::string> DeclarationVisitor::getLines() const { 
-	return lines; 
-}
-
-void DeclarationVisitor::Visit(const Decl *Node) {
-	if (Node == nullptr) {
-		lines.push_back("<empty declaration>");
-		return;
-	}
-
-	// new node = new lines
-	lines.clear();
-
-	ConstDeclVisitor<DeclarationVisitor>::Visit(Node);
-	// no processed lines for this node
-	if (lines.empty()) {
-		lines.push_back(std::string("# cannot processing declaration: ") + Node->getDeclKindName());
-
-		Node->dumpColor();
-	}
-}
-
-void DeclarationVisitor::VisitFunctionDecl(const FunctionDecl* F) {
-	std::stringstream str;
-	str << "def " << F->getNameAsString() << "(";
-
-	size_t i = 0;
-	for (auto* p : F->parameters()) {
-		str << (i > 0 ? ", " : "") << p->getNameAsString();
-		i++;
-	}
-	str << "):";
-	lines.push_back(str.str());
-
-	lines.push_back(std::string("# Body statement type: ") + F->getBody()->getStmtClassName());
-
-	StatementVisitor visitor(F->getBody());
-	auto bodyLines = visitor.getLines();
-	shiftLines(bodyLines);
-	lines.insert(lines.end(), bodyLines.begin(), bodyLines.end());
-}
-
-void DeclarationVisitor::VisitCXXRecordDecl(const CXXRecordDecl* R) {
-	if (R->isStruct()) {
-		_visitRecordDecl(R);
-	}
-	else if (R->isClass()) {
-		_visitRecordDecl(R);
-	}
-	else {
-		lines.push_back(std::string("# unsupported cxxstruct ") + R->getNameAsString());
-	}
-}
-
-void DeclarationVisitor::VisitEnumDecl(const EnumDecl * D) {
-	size_t idx = 0;
-	for (const auto* i : D->enumerators()) {
-		std::stringstream str;
-		str << i->getNameAsString() << " = ";
-		if (const auto* expr = i->getInitExpr(); expr != nullptr) {
-			str << processExpr(expr);
-		}
-		else {
-			str << idx++;
-		}
-		lines.push_back(str.str());
-	}
-}
-
-void DeclarationVisitor::VisitFieldDecl(const FieldDecl* F) {
-	std::stringstream str;
-	str << "self." << F->getNameAsString();
-	if (F->hasInClassInitializer()) {
-		str << " = " << processExpr(F->getInClassInitializer());
-	}
-	else {
-		str << " = None";
-	}
-	
-	Qualifiers qf;
-	LangOptions lo;
-	PrintingPolicy pp(lo);
-	auto t = F->getType();
-
-	lines.push_back("# field type: " + QualType::getAsString(t.getTypePtr(), qf, pp));
-	lines.push_back(std::string("# access: ") + (F->getAccess() == AS_public ? "public" : "non-public"));
-	auto access = F->getAccess();
-	lines.push_back(str.str());
-}
-
-void DeclarationVisitor::VisitCXXConstructorDecl(const CXXConstructorDecl* C) {
-	if (C->getBody() != nullptr) {
-		std::stringstream head;
-		head << "def __init__(self";
-		for (const auto* p : C->parameters()) {
-			head << ", " << p->getNameAsString();
-		}
-		head << "):";
-		lines.push_back("# user constructor");
-		lines.push_back(head.str());
-
-		std::list<std::string> initLines;
-		for (const auto* init : C->inits()) {
-			if (init->getMember() != nullptr) {
-				std::stringstream sInit;
-				sInit << "self." << init->getMember()->getNameAsString() <<
-					" = " << processExpr(init->getInit());
-				initLines.push_back(sInit.str());
-			}
-		}
-		addLines(lines, shiftLinesRet(initLines));
-
-		StatementVisitor body(C->getBody());
-		addLines(lines, shiftLinesRet(body.getLines()));
-	}
-	else {
-		lines.push_back("# ignore default constructor");
-	}
-}
-
-void DeclarationVisitor::VisitCXXMethodDecl(const CXXMethodDecl* M) {
-	if (!M->isCanonicalDecl()) {
-		lines.push_back("# external declaration of " + M->getQualifiedNameAsString());
-		return;
-	}
-
-	std::stringstream comment;
-	//comment << "# isDefined: " << M->isDefined();
-	//comment << " isCanonicalDecl: " << M->isCanonicalDecl();
-	//comment << " hasSkippedBody: " << M->hasSkippedBody();
-	//comment << " willHaveBody: " << M->willHaveBody();
-
-	std::stringstream method;
-	method << "def " << M->getNameAsString() << "(self";
-	size_t pi = 0;
-	for (const auto* p : M->parameters()) {
-		method << ", " << p->getNameAsString();
-	}
-	method << "):";
-
-	
-	lines.push_back(comment.str());
-	lines.push_back(method.str());
-	if (M->isPure()) {
-		addLines(lines, shiftLinesRet(std::list<std::string>{ "None" }));
-	}
-	else {
-		StatementVisitor body(M->getBody());
-		addLines(lines, shiftLinesRet(body.getLines()));
-	}
-}
-
-void DeclarationVisitor::VisitVarDecl(const VarDecl * D)
-{
-	lines.push_back(D->getNameAsString() + " = " + processExpr(D->getInit()));
-}
-
-void DeclarationVisitor::_visitRecordDecl(const CXXRecordDecl * R) {
-	if (!R->isThisDeclarationADefinition()) {
-		lines.push_back("# forward declaration of " + R->getNameAsString());
-		return;
-	}
-
-	std::stringstream head;
-	head << "class " << R->getNameAsString();
-	if (R->getNumBases() > 0) {
-		size_t idx = 0;
-		head << "(";
-		for (auto b : R->bases()) {
-			head << (idx++ > 0 ? ", " : "") << b.getType()->getAsCXXRecordDecl()->getNameAsString();
-		}
-		head << "):";
-	}
-	else {
-		head << ":";
-	}
-	lines.push_back(head.str());
-
-	std::list<std::string> classLines;
-	classLines.push_back("# default implementation");
-	classLines.push_back("def __init__(self):");
-
-	for (const auto* f : R->fields()) {
-		DeclarationVisitor fv(f);
-		addLines(classLines, shiftLinesRet(fv.getLines()));
-	}
-
-	addLines(lines, shiftLinesRet(classLines));
-
-	bool isAllBodies = true;
-	for (const auto* m : R->methods()) {
-		// is this a method, not constructor
-		bool isMethod = !isa<CXXConstructorDecl>(m) && !isa<CXXDestructorDecl>(m)
-			&& !m->isCopyAssignmentOperator() && !m->isMoveAssignmentOperator() && !m->isDestroyingOperatorDelete();
-
-		// add constructor with body
-		isMethod |= (m->getBody() != nullptr);
-
-		if (isMethod) {
-			DeclarationVisitor method(m);
-			addLines(lines, shiftLinesRet(method.getLines()));
-		}
-		else {
-			addLines(lines, shiftLinesRet(LinesList{ "# skip " + m->getQualifiedNameAsString() }));
-		}
-
-		// do not check of pure virtual methods
-		if (isMethod && !m->isPure()) {
-			isAllBodies &= (m->getBody() != nullptr);
-		}
-	}
-
-	if (!isAllBodies) {
-		lines.clear();
-		lines.push_back("# skipped declaration of " + R->getQualifiedNameAsString());
-	}
-}
-
-void DeclarationVisitor::_visitClassDecl(const CXXRecordDecl * R) {
-}
+#include "DeclarationVisitor.h"
+#include "StatementVisitor.h"
+#include "ExpressionProcessor.h"
+#include "ClassLayout.h"
+#include "Lines.h"
+#include "TranslationOptions.h"
+#include "TypeMapper.h"
+#include "TranslationStats.h"
+#include "UnsupportedNodes.h"
+
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/Type.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+
+static bool isCython() {
+	return getTranslationOptions().backend == Backend::Cython;
+}
+
+// parameters are typed for cython: 'double x'
+static std::string getParameterName(const ParmVarDecl* P) {
+	if (isCython()) {
+		if (auto type = getCythonType(P->getType(), P->getASTContext())) {
+			return *type + " " + P->getNameAsString();
+		}
+	}
+	return P->getNameAsString();
+}
+
+// typed locals of function body. Cython allows cdef only at function level, so locals of
+// nested blocks and loop indices are hoisted. Names declared with different types stay untyped
+static void collectCythonLocals(const Stmt* S, const ASTContext& Context, std::vector<std::string>& names,
+	llvm::StringMap<std::optional<std::string>>& types, std::vector<const VarDecl*>& decls) {
+	if (S == nullptr || isa<LambdaExpr>(S)) {
+		return;
+	}
+
+	if (const auto* declStmt = dyn_cast<DeclStmt>(S)) {
+		for (const auto* d : declStmt->decls()) {
+			const auto* vd = dyn_cast<VarDecl>(d);
+			if (vd == nullptr || vd->isStaticLocal() || vd->getName().empty()) continue;
+
+			decls.push_back(vd);
+			auto type = getCythonType(vd->getType(), Context);
+			auto [it, isNew] = types.try_emplace(vd->getName(), type);
+			if (isNew) {
+				names.push_back(vd->getNameAsString());
+			}
+			else if (it->second != type) {
+				it->second = std::nullopt;
+			}
+		}
+	}
+	for (const auto* child : S->children()) {
+		collectCythonLocals(child, Context, names, types, decls);
+	}
+}
+
+// translated function body, for cython it starts with cdef of typed locals
+static LineBuffer translateBody(const FunctionDecl* F) {
+	const FunctionDecl* definition = F;
+	const auto* Body = F->getBody(definition);
+	if (!isCython()) {
+		StatementVisitor visitor(Body);
+		return visitor.takeLines();
+	}
+
+	std::vector<std::string> names;
+	llvm::StringMap<std::optional<std::string>> types;
+	std::vector<const VarDecl*> decls;
+	collectCythonLocals(Body, F->getASTContext(), names, types, decls);
+
+	// local of nested block may have name of parameter, its cdef would redeclare parameter
+	llvm::StringSet<> parameters;
+	for (const auto* p : F->parameters()) parameters.insert(p->getName());
+	for (const auto* p : definition->parameters()) parameters.insert(p->getName());
+
+	llvm::StringSet<> used = parameters;
+	for (const auto& name : names) used.insert(name);
+
+	llvm::StringMap<std::string> renamed;
+	for (const auto& name : names) {
+		if (!types[name] || !parameters.count(name)) continue;
+
+		auto newName = name + "_";
+		while (used.count(newName)) newName += "_";
+		used.insert(newName);
+		renamed[name] = newName;
+	}
+
+	llvm::DenseMap<const VarDecl*, std::string> localNames;
+	for (const auto* d : decls) {
+		auto it = renamed.find(d->getName());
+		if (it != renamed.end()) localNames[d] = it->second;
+	}
+	LocalNameScope scope(std::move(localNames));
+	StatementVisitor visitor(Body);
+
+	LineBuffer lines;
+	for (const auto& name : names) {
+		if (const auto& type = types[name]) {
+			auto it = renamed.find(name);
+			lines.push_back("cdef " + *type + " " + (it != renamed.end() ? it->second : name));
+		}
+	}
+	addLines(lines, visitor.takeLines());
+	return lines;
+}
+
+// cython extension types support only single inheritance from other extension type
+static bool isCdefClass(const CXXRecordDecl* R) {
+	if (!isCython() || R == nullptr || !R->hasDefinition() || R->getNumBases() > 1) {
+		return false;
+	}
+	for (const auto& b : R->bases()) {
+		if (!isCdefClass(b.getType()->getAsCXXRecordDecl())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+DeclarationVisitor::DeclarationVisitor(const Decl* Node) {
+	PhaseScope phase(Phase::Declarations);
+	Visit(Node);
+}
+
+LineBuffer DeclarationVisitor::takeLines() {
+	return std::move(lines);
+}
+
+void DeclarationVisitor::Visit(const Decl *Node) {
+	if (Node == nullptr) {
+		lines.push_back("<empty declaration>");
+		return;
+	}
+
+	// new node = new lines
+	lines.clear();
+
+	countNode(Node);
+	ConstDeclVisitor<DeclarationVisitor>::Visit(Node);
+	// no processed lines for this node
+	if (lines.empty()) {
+		lines.push_back(std::string("# cannot processing declaration: ") + Node->getDeclKindName());
+		reportUnsupported(Node);
+	}
+}
+
+void DeclarationVisitor::VisitFunctionDecl(const FunctionDecl* F) {
+	std::stringstream str;
+	str << "def " << F->getNameAsString() << "(";
+
+	size_t i = 0;
+	for (auto* p : F->parameters()) {
+		str << (i > 0 ? ", " : "") << getParameterName(p);
+		i++;
+	}
+	str << "):";
+
+	// body of function from other file or prototype
+	if (F->getBody() == nullptr) {
+		lines.push_back("# declaration of " + F->getNameAsString());
+		return;
+	}
+
+	// functions which cannot be typed stay plain python
+	if (getTranslationOptions().backend == Backend::Numba) {
+		if (auto signature = getNumbaSignature(F)) {
+			lines.push_back("@njit(\"" + *signature + "\", cache=True)");
+		}
+	}
+	lines.push_back(str.str());
+
+	lines.push_back(std::string("# Body statement type: ") + F->getBody()->getStmtClassName());
+
+	addLines(lines, shiftLinesRet(translateBody(F)));
+}
+
+void DeclarationVisitor::VisitCXXRecordDecl(const CXXRecordDecl* R) {
+	if (R->isStruct()) {
+		_visitRecordDecl(R);
+	}
+	else if (R->isClass()) {
+		_visitRecordDecl(R);
+	}
+	else {
+		lines.push_back(std::string("# unsupported cxxstruct ") + R->getNameAsString());
+	}
+}
+
+void DeclarationVisitor::VisitEnumDecl(const EnumDecl * D) {
+	for (const auto* i : D->enumerators()) {
+		std::stringstream str;
+		str << i->getNameAsString() << " = ";
+		if (const auto* expr = i->getInitExpr(); expr != nullptr) {
+			str << processExpr(expr);
+		}
+		else {
+			// implicit value continues from previous initializer
+			str << i->getInitVal().toString(10);
+		}
+		lines.push_back(str.str());
+	}
+}
+
+void DeclarationVisitor::VisitFieldDecl(const FieldDecl* F) {
+	std::stringstream str;
+	str << "self." << F->getNameAsString();
+	if (F->hasInClassInitializer()) {
+		str << " = " << processExpr(F->getInClassInitializer());
+	}
+	else if (auto type = isCython() ? getCythonType(F->getType(), F->getASTContext()) : std::nullopt) {
+		// typed attribute of cdef class cannot hold None
+		str << (*type == "bint" ? " = False" : " = 0");
+	}
+	else {
+		str << " = None";
+	}
+	
+	Qualifiers qf;
+	LangOptions lo;
+	PrintingPolicy pp(lo);
+	auto t = F->getType();
+
+	lines.push_back("# field type: " + QualType::getAsString(t.getTypePtr(), qf, pp));
+	lines.push_back(std::string("# access: ") + (F->getAccess() == AS_public ? "public" : "non-public"));
+	auto access = F->getAccess();
+	lines.push_back(str.str());
+}
+
+void DeclarationVisitor::VisitCXXConstructorDecl(const CXXConstructorDecl* C) {
+	if (C->getBody() != nullptr) {
+		std::stringstream head;
+		head << "def __init__(self";
+		for (const auto* p : C->parameters()) {
+			head << ", " << getParameterName(p);
+		}
+		head << "):";
+		lines.push_back("# user constructor");
+		lines.push_back(head.str());
+
+		LineBuffer initLines;
+		for (const auto* init : C->inits()) {
+			if (init->getMember() != nullptr) {
+				std::stringstream sInit;
+				sInit << "self." << init->getMember()->getNameAsString() <<
+					" = " << processExpr(init->getInit());
+				initLines.push_back(sInit.str());
+			}
+		}
+		addLines(lines, shiftLinesRet(std::move(initLines)));
+		addLines(lines, shiftLinesRet(translateBody(C)));
+	}
+	else {
+		lines.push_back("# ignore default constructor");
+	}
+}
+
+void DeclarationVisitor::VisitCXXMethodDecl(const CXXMethodDecl* M) {
+	if (!M->isCanonicalDecl()) {
+		lines.push_back("# external declaration of " + M->getQualifiedNameAsString());
+		return;
+	}
+
+	std::stringstream comment;
+	//comment << "# isDefined: " << M->isDefined();
+	//comment << " isCanonicalDecl: " << M->isCanonicalDecl();
+	//comment << " hasSkippedBody: " << M->hasSkippedBody();
+	//comment << " willHaveBody: " << M->willHaveBody();
+
+	std::stringstream method;
+	method << "def " << M->getNameAsString() << "(self";
+	size_t pi = 0;
+	for (const auto* p : M->parameters()) {
+		method << ", " << getParameterName(p);
+	}
+	method << "):";
+
+	
+	lines.push_back(comment.str());
+	lines.push_back(method.str());
+	if (M->isPure() || M->getBody() == nullptr) {
+		addLines(lines, shiftLinesRet(LineBuffer{ "None" }));
+	}
+	else {
+		addLines(lines, shiftLinesRet(translateBody(M)));
+	}
+}
+
+void DeclarationVisitor::VisitVarDecl(const VarDecl * D)
+{
+	lines.push_back(D->getNameAsString() + " = " + processExpr(D->getInit()));
+}
+
+void DeclarationVisitor::_visitRecordDecl(const CXXRecordDecl * R) {
+	if (!R->isThisDeclarationADefinition()) {
+		lines.push_back("# forward declaration of " + R->getNameAsString());
+		return;
+	}
+
+	bool isCdef = isCdefClass(R);
+
+	std::stringstream head;
+	head << (isCdef ? "cdef class " : "class ") << R->getNameAsString();
+	if (R->getNumBases() > 0) {
+		size_t idx = 0;
+		head << "(";
+		for (auto b : R->bases()) {
+			head << (idx++ > 0 ? ", " : "") << b.getType()->getAsCXXRecordDecl()->getNameAsString();
+		}
+		head << "):";
+	}
+	else {
+		head << ":";
+	}
+	lines.push_back(head.str());
+
+	LineBuffer classLines;
+	// attributes of extension type are declared in class body
+	if (isCdef) {
+		for (const auto* f : R->fields()) {
+			auto type = getCythonType(f->getType(), f->getASTContext());
+			classLines.push_back("cdef public " + type.value_or("object") + " " + f->getNameAsString());
+		}
+	}
+	if (canUseSlots(R)) {
+		// inherited fields are in slots of bases
+		std::string slots = "__slots__ = (";
+		size_t fieldCount = 0;
+		for (const auto* f : R->fields()) {
+			slots += (fieldCount++ > 0 ? ", '" : "'") + f->getNameAsString() + "'";
+		}
+		classLines.push_back(slots + (fieldCount == 1 ? ",)" : ")"));
+	}
+	classLines.push_back("# default implementation");
+	classLines.push_back("def __init__(self):");
+
+	for (const auto* f : R->fields()) {
+		DeclarationVisitor fv(f);
+		addLines(classLines, shiftLinesRet(fv.takeLines()));
+	}
+
+	addLines(lines, shiftLinesRet(std::move(classLines)));
+
+	bool isAllBodies = true;
+	for (const auto* m : R->methods()) {
+		// is this a method, not constructor
+		bool isMethod = !isa<CXXConstructorDecl>(m) && !isa<CXXDestructorDecl>(m)
+			&& !m->isCopyAssignmentOperator() && !m->isMoveAssignmentOperator() && !m->isDestroyingOperatorDelete();
+
+		// add constructor with body
+		isMethod |= (m->getBody() != nullptr);
+
+		if (isMethod) {
+			DeclarationVisitor method(m);
+			addLines(lines, shiftLinesRet(method.takeLines()));
+		}
+		else {
+			addLines(lines, shiftLinesRet(LineBuffer{ "# skip " + m->getQualifiedNameAsString() }));
+		}
+
+		// do not check of pure virtual methods
+		if (isMethod && !m->isPure()) {
+			isAllBodies &= (m->getBody() != nullptr);
+		}
+	}
+
+	if (!isAllBodies) {
+		lines.clear();
+		lines.push_back("# skipped declaration of " + R->getQualifiedNameAsString());
+	}
+}
+
+void DeclarationVisitor::_visitClassDecl(const CXXRecordDecl * R) {
+}
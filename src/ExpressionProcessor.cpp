@@ -1,411 +1,1104 @@
-#include "ExpressionProcessor.h"
-#include "StatementVisitor.h"
-#include "clang/AST/ExprCXX.h"
-#include <sstream>
-
-typedef std::pair<std::string, size_t> ExprResult;
-ExprResult processExprInt(const Expr* E);
-
-std::map<BinaryOperator::Opcode, std::string> strs4opcode = {
-	{ BO_Add, "+"},
-	{ BO_Sub, "-"},
-	{ BO_Div, "/"},
-	{ BO_Mul, "*"},
-	{ BO_GT, ">" },
-	{ BO_GE, ">=" },
-	{ BO_LT, "<" },
-	{ BO_LE, "<=" },
-	{ BO_EQ, "==" },
-	{ BO_Assign, "=" },
-	{ BO_And, " and "},
-	{ BO_LAnd, " and "},
-	{ BO_LOr, " or "},
-	{ BO_Or, " or "},
-	{ BO_MulAssign, " *= "},
-	{ BO_AddAssign, " += "},
-	{ BO_DivAssign, " /= "},
-	{ BO_SubAssign, " -= "}
-};
-
-std::map<UnaryOperator::Opcode, std::string> strs4uopcode = {
-	{ UO_PostDec, "--"},
-	{ UO_PreDec, "--"},
-	{ UO_PostInc, "++"},
-	{ UO_PreInc, "++"}
-};
-
-std::string opcode2Str(BinaryOperator::Opcode code) {
-	auto it = strs4opcode.find(code);
-	if (it != strs4opcode.end()) {
-		return it->second;
-	}
-	else {
-		return "<opcode>";
-	}
-}
-
-std::string opcode2Str(UnaryOperator::Opcode code) {
-	auto it = strs4uopcode.find(code);
-	if (it != strs4uopcode.end()) {
-		return it->second;
-	}
-	else {
-		return "<uopcode>";
-	}
-}
-
-std::string getExpResultAsStr(const ExprResult& res, BinaryOperator::Opcode code) {
-	if (res.second == 1) {
-		return res.first;
-	}
-	else {
-		return std::string("(") + res.first + std::string(")");
-	}
-}
-
-ExprResult processBinaryOperator(const BinaryOperator* B) {
-	auto code = B->getOpcode();
-
-	auto left = processExprInt(B->getLHS());
-	auto right = processExprInt(B->getRHS());
-	std::string res = getExpResultAsStr(left, code) + opcode2Str(code) + getExpResultAsStr(right, code);
-
-	size_t level = std::max(left.second, right.second);
-	if (code != BO_Mul)
-		return { res , level + 1 };
-	else 
-		return { res , level };
-}
-
-ExprResult processImplicitCast(const ImplicitCastExpr* E) {
-	const auto* ee = E->getSubExpr();
-	//TODO check types
-	return processExprInt(ee);
-}
-
-ExprResult processFloatingLiteral(const FloatingLiteral* F) {
-	std::stringstream str;
-	str << F->getValueAsApproximateDouble();
-	return { str.str(), 1 };
-}
-
-ExprResult processIntegerLiteral(const IntegerLiteral* F) {
-	return { F->getValue().toString(10, false), 1 };
-}
-
-ExprResult processBoolLiteral(const CXXBoolLiteralExpr* B) {
-	return { B->getValue() ? "True" : "False", 1 };
-}
-
-ExprResult processDeclRef(const DeclRefExpr* D) {
-	const auto* v = D->getDecl();
-	if (v != nullptr) {
-		return { v->getNameAsString(), 1 };
-	}
-	else {
-		return {"<unknown variable>", 1 };
-	}
-}
-
-ExprResult processCall(const CallExpr* C) {
-	const auto* d = C->getCalleeDecl();
-	if (const auto* f = dyn_cast<FunctionDecl>(d); f != nullptr) {
-		std::stringstream str;
-		auto fName = f->getNameAsString();
-		if (fName == "operator[]") {
-			auto first = processExpr(C->getArg(0));
-			auto second = processExpr(C->getArg(1));
-			str << first << "[" << second << "]";
-		}
-		else if (fName == "operator()") {
-			auto first = processExpr(C->getArg(0));
-			str << first << "(";
-			for (size_t i = 1; i < C->getNumArgs(); ++i) {
-				if (i > 1) str << ", ";
-				str << processExprInt(C->getArg(i)->getExprStmt()).first;
-			}
-			str << ")";
-		}
-		else {
-			str << fName + "(";
-			for (size_t i = 0; i < C->getNumArgs(); ++i) {
-				if (i > 0) str << ", ";
-				str << processExprInt(C->getArg(i)->getExprStmt()).first;
-			}
-			str << ")";
-		}
-		return { str.str(), 1 };
-	}
-	else {
-		return { "<unknown call>", 1 };
-	}
-}
-
-ExprResult processMember(const MemberExpr* M) {
-	const auto* member = M->getMemberDecl();
-	const auto* object = M->getBase();
-
-	std::stringstream str;
-	str << processExpr(object) << "." << member->getNameAsString();
-	return { str.str(), 1 };
-}
-
-ExprResult processMemberCall(const CXXMemberCallExpr* M) {
-	std::stringstream str;
-
-	const auto* member = M->getMethodDecl();
-	const Expr* object = M->getImplicitObjectArgument();
-
-	auto mName = member->getNameAsString();
-	// replace size() -> len()
-	if (mName == "size" && M->getNumArgs() == 0) {
-		str << "len(" << processExpr(object) << ")";
-	}
-	else if (mName == "operator[]") {
-		auto first = processExpr(M->getArg(0));
-		auto second = processExpr(M->getArg(1));
-		str << first << "[" << second << "]";
-	}
-	else {
-		str << processExpr(object) << "." << member->getNameAsString() << "(";
-
-		size_t idx = 0;
-		for (const auto* p : M->arguments()) {
-			str << (idx++ > 0 ? ", " : "") << processExpr(p);
-		}
-		str << ")";
-	}
-
-	return { str.str(), 1 };
-}
-
-ExprResult processThis(const CXXThisExpr* Th) {
-	return { "self", 1 };
-}
-
-ExprResult processDefaultInit(const CXXDefaultInitExpr* Ie) {
-	return { processExpr(Ie->getExpr()) , 1 };
-}
-
-ExprResult processCXXConstruct(const CXXConstructExpr* C) {
-	std::string typeName(C->getConstructor()->getParent()->getNameAsString());
-	std::stringstream str;
-	str << typeName << "(";
-	size_t idx = 0;
-	for (const auto* p : C->arguments()) {
-		if (p->isDefaultArgument()) {
-			continue;
-		}
-		str << (idx++ > 0 ? ", " : "") << processExpr(p);
-	}
-	str << ")";
-
-	return { str.str(), 1 };
-}
-
-ExprResult processConstant(const ConstantExpr* C) {
-	return { processExpr(C->getSubExpr()) , 1 };
-}
-
-ExprResult processExprWithCleanups(const ExprWithCleanups* E) {
-	return { processExpr(E->getSubExpr()) , 1 };
-}
-
-ExprResult processCXXStdInitializerList(const CXXStdInitializerListExpr* L) {
-	return { processExpr(L->getSubExpr()), 1 };
-}
-
-ExprResult processMaterializeTemporary(const MaterializeTemporaryExpr* E) {
-	return { processExpr(E->getSubExpr()), 1 };
-}
-
-ExprResult processInitList(const InitListExpr* L) {
-	std::stringstream str;
-	str << "[";
-	for (size_t i = 0; i < L->getNumInits(); i++) {
-		str << (i > 0 ? ", " : "") << processExpr(L->getInit(i));
-	}
-	str << "]";
-	return { str.str(), 1 };
-}
-
-ExprResult processParenExpr(const ParenExpr* E) {
-	return processExprInt(E->getSubExpr());
-}
-
-ExprResult processUnaryOperator(const UnaryOperator* O) {
-	// copy from StatementVisitor::VisitUnaryOperator()
-	auto expr = processExpr(O->getSubExpr());
-	auto code = O->getOpcode();
-	switch (code)
-	{
-	case UnaryOperator::Opcode::UO_PostDec:
-	case UnaryOperator::Opcode::UO_PreDec:
-		return { expr + " = " + expr + " - 1", 1 };
-	case UnaryOperator::Opcode::UO_PostInc:
-	case UnaryOperator::Opcode::UO_PreInc:
-		return { expr + " = " + expr + " + 1", 1 };
-	case UnaryOperator::Opcode::UO_Not:
-	case UnaryOperator::Opcode::UO_LNot:
-		return { "not " + expr, 1 };
-	case UnaryOperator::Opcode::UO_Minus:
-		return { "-(" + expr + ")", 1 };
+#include "ExpressionProcessor.h"
+#include "CallRules.h"
+#include "StatementVisitor.h"
+#include "ContainerLowering.h"
+#include "Lines.h"
+#include "TranslationContext.h"
+#include "TranslationOptions.h"
+#include "TranslationStats.h"
+#include "UnsupportedNodes.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtVisitor.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+#include <array>
+#include <cassert>
+#include <charconv>
+
+// python operator precedence, from the loosest to the tightest binding
+enum Precedence {
+	PREC_STATEMENT,      // x = y, x += y: valid only as a whole statement
+	PREC_LAMBDA,
+	PREC_CONDITIONAL,    // a if c else b
+	PREC_OR,
+	PREC_AND,
+	PREC_NOT,
+	PREC_COMPARISON,     // <, <=, ==, ... (chained in python, so never nested without parentheses)
+	PREC_BIT_OR,
+	PREC_BIT_XOR,
+	PREC_BIT_AND,
+	PREC_SHIFT,
+	PREC_ADDITIVE,
+	PREC_MULTIPLICATIVE,
+	PREC_UNARY,          // -x, +x, ~x
+	PREC_POWER,
+	PREC_PRIMARY,        // x[i], f(x), x.attr
+	PREC_ATOM            // names, literals, [...]
+};
+
+struct OperatorInfo {
+	const char* text;
+	Precedence precedence;
+};
+
+constexpr OperatorInfo getOperatorInfo(BinaryOperator::Opcode code) {
+	switch (code) {
+	case BO_Mul: return { "*", PREC_MULTIPLICATIVE };
+	case BO_Div: return { "/", PREC_MULTIPLICATIVE };
+	case BO_Rem: return { "%", PREC_MULTIPLICATIVE };
+	case BO_Add: return { "+", PREC_ADDITIVE };
+	case BO_Sub: return { "-", PREC_ADDITIVE };
+	case BO_Shl: return { "<<", PREC_SHIFT };
+	case BO_Shr: return { ">>", PREC_SHIFT };
+	case BO_LT: return { "<", PREC_COMPARISON };
+	case BO_GT: return { ">", PREC_COMPARISON };
+	case BO_LE: return { "<=", PREC_COMPARISON };
+	case BO_GE: return { ">=", PREC_COMPARISON };
+	case BO_EQ: return { "==", PREC_COMPARISON };
+	case BO_NE: return { "!=", PREC_COMPARISON };
+	case BO_And: return { "&", PREC_BIT_AND };
+	case BO_Xor: return { "^", PREC_BIT_XOR };
+	case BO_Or: return { "|", PREC_BIT_OR };
+	case BO_LAnd: return { "and", PREC_AND };
+	case BO_LOr: return { "or", PREC_OR };
+	case BO_Assign: return { "=", PREC_STATEMENT };
+	case BO_MulAssign: return { "*=", PREC_STATEMENT };
+	case BO_DivAssign: return { "/=", PREC_STATEMENT };
+	case BO_RemAssign: return { "%=", PREC_STATEMENT };
+	case BO_AddAssign: return { "+=", PREC_STATEMENT };
+	case BO_SubAssign: return { "-=", PREC_STATEMENT };
+	case BO_ShlAssign: return { "<<=", PREC_STATEMENT };
+	case BO_ShrAssign: return { ">>=", PREC_STATEMENT };
+	case BO_AndAssign: return { "&=", PREC_STATEMENT };
+	case BO_XorAssign: return { "^=", PREC_STATEMENT };
+	case BO_OrAssign: return { "|=", PREC_STATEMENT };
+	default: return { "<opcode>", PREC_STATEMENT };
+	}
+}
+
+constexpr OperatorInfo getOperatorInfo(UnaryOperator::Opcode code) {
+	switch (code) {
+	case UO_PostInc:
+	case UO_PreInc: return { "++", PREC_STATEMENT };
+	case UO_PostDec:
+	case UO_PreDec: return { "--", PREC_STATEMENT };
+	case UO_Plus: return { "+", PREC_UNARY };
+	case UO_Minus: return { "-", PREC_UNARY };
+	case UO_Not: return { "~", PREC_UNARY };
+	case UO_LNot: return { "not ", PREC_NOT };
+	default: return { "<uopcode>", PREC_STATEMENT };
+	}
+}
+
+// opcode -> python operator, built at compile time
+constexpr auto binaryOperators = [] {
+	std::array<OperatorInfo, BO_Comma + 1> table{};
+	for (size_t i = 0; i < table.size(); i++) {
+		table[i] = getOperatorInfo(static_cast<BinaryOperator::Opcode>(i));
+	}
+	return table;
+}();
+
+constexpr auto unaryOperators = [] {
+	std::array<OperatorInfo, UO_Coawait + 1> table{};
+	for (size_t i = 0; i < table.size(); i++) {
+		table[i] = getOperatorInfo(static_cast<UnaryOperator::Opcode>(i));
+	}
+	return table;
+}();
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// shortest python literal which reads back to the same value
+std::string getFloatLiteral(const llvm::APFloat& value) {
+	if (value.isNaN()) {
+		return "float('nan')";
+	}
+	if (value.isInfinity()) {
+		return value.isNegative() ? "-float('inf')" : "float('inf')";
+	}
+
+	char buffer[32];
+	std::to_chars_result res;
+	if (&value.getSemantics() == &llvm::APFloat::IEEEsingle()) {
+		res = std::to_chars(buffer, buffer + sizeof(buffer), value.convertToFloat());
+	}
+	else {
+		bool losesInfo = false;
+		llvm::APFloat converted = value;
+		converted.convert(llvm::APFloat::IEEEdouble(), llvm::APFloat::rmNearestTiesToEven, &losesInfo);
+		res = std::to_chars(buffer, buffer + sizeof(buffer), converted.convertToDouble());
+	}
+
+	std::string text(buffer, res.ptr);
+	if (text.find_first_of(".e") == std::string::npos) {
+		text += ".0";
+	}
+	return text;
+}
+
+// active alias scopes, innermost last
+thread_local std::vector<ExpressionAliasScope*> aliasScopes;
+
+const std::string* findAlias(llvm::StringRef text) {
+	for (auto it = aliasScopes.rbegin(); it != aliasScopes.rend(); ++it) {
+		if (const auto* name = (*it)->find(text)) {
+			return name;
+		}
+	}
+	return nullptr;
+}
+
+std::string getAlias(std::string text) {
+	const auto* name = findAlias(text);
+	return name != nullptr ? *name : text;
+}
+
+// iterator as position in container: 'v.begin() + a' is {v, a}, 'v.end()' is {v, null, true}
+struct IteratorPosition {
+	const Expr* container = nullptr;
+	const Expr* offset = nullptr;
+	bool isEnd = false;
+};
+
+// without implicit casts, temporaries and iterator copies
+const Expr* stripIterator(const Expr* E) {
+	E = E->IgnoreImplicit();
+	if (const auto* construct = dyn_cast<CXXConstructExpr>(E); construct != nullptr && construct->getNumArgs() == 1) {
+		return stripIterator(construct->getArg(0));
+	}
+	return E->IgnoreParens();
+}
+
+std::optional<IteratorPosition> getIteratorPosition(const Expr* E) {
+	E = stripIterator(E);
+
+	const Expr* container = nullptr;
+	std::string name;
+	if (const auto* member = dyn_cast<CXXMemberCallExpr>(E); member != nullptr && member->getMethodDecl() != nullptr) {
+		container = member->getImplicitObjectArgument();
+		name = member->getMethodDecl()->getNameAsString();
+	}
+	else if (const auto* call = dyn_cast<CallExpr>(E); call != nullptr && call->getNumArgs() == 1 && !isa<CXXOperatorCallExpr>(E)
+		&& call->getDirectCallee() != nullptr && call->getDirectCallee()->isInStdNamespace()) {
+		// std::begin(v)
+		container = call->getArg(0);
+		name = call->getDirectCallee()->getNameAsString();
+	}
+	if (container != nullptr) {
+		if (name == "begin" || name == "cbegin") return IteratorPosition{ container };
+		if (name == "end" || name == "cend") return IteratorPosition{ container, nullptr, true };
+		return std::nullopt;
+	}
+
+	// 'v.begin() + a', 'array + a'
+	const Expr* lhs = nullptr;
+	const Expr* rhs = nullptr;
+	if (const auto* op = dyn_cast<CXXOperatorCallExpr>(E); op != nullptr && op->getOperator() == OO_Plus && op->getNumArgs() == 2) {
+		lhs = op->getArg(0);
+		rhs = op->getArg(1);
+	}
+	else if (const auto* binary = dyn_cast<BinaryOperator>(E); binary != nullptr && binary->getOpcode() == BO_Add) {
+		lhs = binary->getLHS();
+		rhs = binary->getRHS();
+	}
+	if (lhs != nullptr) {
+		auto position = getIteratorPosition(lhs);
+		if (!position || position->offset != nullptr || position->isEnd) return std::nullopt;
+		position->offset = rhs;
+		return position;
+	}
+
+	// array decayed to pointer to its first element
+	if (const auto* ref = dyn_cast<DeclRefExpr>(E); ref != nullptr && ref->getType()->isArrayType()) {
+		return IteratorPosition{ ref };
+	}
+	return std::nullopt;
+}
+
+// argument of call is numpy array or iterator of it
+bool isNumpyArgument(const Expr* E) {
+	if (auto position = getIteratorPosition(E)) {
+		return getNumpyContainer(position->container) != nullptr;
+	}
+	return getNumpyContainer(E) != nullptr;
+}
+
+// numpy form of rule is used when any argument is numpy array
+bool isNumpyRule(const CallRule& rule, const Expr* object, llvm::ArrayRef<const Expr*> args) {
+	return !rule.numpy.empty() && ((object != nullptr && isNumpyArgument(object)) || llvm::any_of(args, isNumpyArgument));
+}
+
+// precedence of rule form: forms with operators on top level are marked as the loosest expressions,
+// so they get parentheses wherever operators are not expected
+Precedence getFormPrecedence(llvm::StringRef form) {
+	int depth = 0;
+	bool hasSpace = false;
+	for (size_t i = 0; i < form.size(); i++) {
+		char c = form[i];
+		if (c == '(' || c == '[' || c == '{') depth++;
+		else if (c == ')' || c == ']' || c == '}') depth--;
+		else if (depth == 0 && c == ' ') {
+			hasSpace = true;
+			if (i + 2 < form.size() && form[i + 1] == '=' && form[i + 2] == ' ') return PREC_STATEMENT;
+		}
+	}
+	return hasSpace ? PREC_CONDITIONAL : PREC_PRIMARY;
+}
+
+// length of callee at the beginning of rule form: 'math.sqrt' of 'math.sqrt({0})', '{self}.append' of '{self}.append({0})'
+size_t getFormCalleeLength(llvm::StringRef form) {
+	size_t length = form.startswith("{self}.") ? 7 : 0;
+	size_t start = length;
+	while (length < form.size() && (isalnum(static_cast<unsigned char>(form[length])) || form[length] == '_' || form[length] == '.')) {
+		length++;
+	}
+	return length > start && length < form.size() && form[length] == '(' ? length : 0;
+}
+
+// c++ source of expression in one line
+std::string getSourceText(const Expr* E, const ASTContext& Context) {
+	auto range = CharSourceRange::getTokenRange(E->getSourceRange());
+	auto text = Lexer::getSourceText(range, Context.getSourceManager(), Context.getLangOpts());
+
+	std::string line;
+	for (char c : text) {
+		bool isSpace = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+		if (!isSpace) line += c;
+		else if (!line.empty() && line.back() != ' ') line += ' ';
+	}
+	return line;
+}
+
+// python text of expression. Every node kind is dispatched once through StmtVisitor switch,
+// parentheses are added only where python precedence requires them.
+// Text of all nodes is appended to one buffer, so printing is linear in output size
+class ExpressionPrinter : public ConstStmtVisitor<ExpressionPrinter, Precedence> {
+public:
+	// append text of expression to buffer, returns its precedence
+	Precedence print(const Expr* E);
+	// append text of subexpression, in parentheses if it binds looser than minPrecedence
+	void operand(const Expr* E, Precedence minPrecedence);
+	// text of subexpression as separate string, buffer is not changed
+	std::string operandText(const Expr* E, Precedence minPrecedence);
+	// printed text, buffer is cleared
+	std::string takeText();
+
+	// literal of expression evaluated by clang
+	std::optional<Precedence> fold(const Expr* E);
+	// call translated by rule table, nullopt if rule cannot be applied to these arguments
+	std::optional<Precedence> ruleCall(const CallRule& rule, const Expr* object, llvm::ArrayRef<const Expr*> args);
+	// '*std::max_element(...)' by rule of dereferenced call
+	std::optional<Precedence> dereferencedRuleCall(const Expr* E);
+	// 'std::max_element(b, e) - v.begin()' by rule which gives index
+	std::optional<Precedence> iteratorDistance(const Expr* lhs, const Expr* rhs);
+	// 'v', 'v[a:b]' of iterator pair, 'v[:]' for assignment target
+	std::optional<std::string> sequence(const Expr* first, const Expr* last, bool isSlice);
+	// text of called function as it is looked up in loop aliases, empty if call has no callee in python
+	std::string callee(const CallExpr* C);
+
+	Precedence VisitStmt(const Stmt* S);
+	Precedence VisitConstantExpr(const ConstantExpr* C);
+	Precedence VisitExprWithCleanups(const ExprWithCleanups* E);
+	Precedence VisitCXXConstructExpr(const CXXConstructExpr* C);
+	Precedence VisitCXXStdInitializerListExpr(const CXXStdInitializerListExpr* L);
+	Precedence VisitMaterializeTemporaryExpr(const MaterializeTemporaryExpr* E);
+	Precedence VisitInitListExpr(const InitListExpr* L);
+	Precedence VisitParenExpr(const ParenExpr* E);
+	Precedence VisitUnaryOperator(const UnaryOperator* O);
+	Precedence VisitLambdaExpr(const LambdaExpr* L);
+	Precedence VisitBinaryOperator(const BinaryOperator* B);
+	Precedence VisitImplicitCastExpr(const ImplicitCastExpr* E);
+	Precedence VisitConditionalOperator(const ConditionalOperator* O);
+	Precedence VisitFloatingLiteral(const FloatingLiteral* F);
+	Precedence VisitIntegerLiteral(const IntegerLiteral* I);
+	Precedence VisitCXXBoolLiteralExpr(const CXXBoolLiteralExpr* B);
+	Precedence VisitDeclRefExpr(const DeclRefExpr* D);
+	Precedence VisitCXXMemberCallExpr(const CXXMemberCallExpr* M);
+	Precedence VisitCallExpr(const CallExpr* C);
+	Precedence VisitMemberExpr(const MemberExpr* M);
+	Precedence VisitCXXThisExpr(const CXXThisExpr* Th);
+	Precedence VisitCXXDefaultInitExpr(const CXXDefaultInitExpr* Ie);
+	Precedence VisitCXXFunctionalCastExpr(const CXXFunctionalCastExpr* E);
+private:
+	llvm::SmallString<256> buffer;
+	llvm::raw_svector_ostream out{ buffer };
+	llvm::DenseMap<const Stmt*, bool> foldCandidates;
+
+	// precedence of expression before it is printed, nullopt when only printing shows it
+	// (folded literals, rule forms). Parenthesis of such operand is inserted afterwards
+	std::optional<Precedence> getKnownPrecedence(const Expr* E);
+	// expression may be replaced by literal
+	bool mayFold(const Expr* E);
+	// only constants, constexpr calls and operators on them can be folded.
+	// Cheap check which saves from running evaluator on every node of non-constant tree
+	bool isFoldCandidate(const Stmt* S);
+	// replace text printed from start with its loop alias
+	void useAlias(size_t start);
+};
+
+}
+
+Precedence ExpressionPrinter::print(const Expr* E) {
+	if (E == nullptr) {
+		out << "<null expression>";
+		return PREC_ATOM;
+	}
+	countNode(E);
+	if (auto folded = fold(E)) {
+		return *folded;
+	}
+	return Visit(E);
+}
+
+bool ExpressionPrinter::isFoldCandidate(const Stmt* S) {
+	if (auto it = foldCandidates.find(S); it != foldCandidates.end()) {
+		return it->second;
+	}
+
+	// sizeof(x) does not read x
+	if (isa<UnaryExprOrTypeTraitExpr>(S)) {
+		return true;
+	}
+
+	bool result = true;
+	if (const auto* ref = dyn_cast<DeclRefExpr>(S)) {
+		const auto* d = ref->getDecl();
+		const auto* var = dyn_cast<VarDecl>(d);
+		result = isa<EnumConstantDecl>(d) || isa<NonTypeTemplateParmDecl>(d) || isa<FunctionDecl>(d)
+			|| (var != nullptr && (var->isConstexpr() || var->getType().isConstQualified()));
+	}
+	else if (const auto* member = dyn_cast<MemberExpr>(S)) {
+		const auto* var = dyn_cast<VarDecl>(member->getMemberDecl());
+		result = var != nullptr && var->isConstexpr();
+	}
+	else if (const auto* call = dyn_cast<CallExpr>(S)) {
+		const auto* f = call->getDirectCallee();
+		result = f != nullptr && f->isConstexpr();
+	}
+	else if (isa<CXXThisExpr>(S) || isa<LambdaExpr>(S) || isa<StringLiteral>(S)) {
+		result = false;
+	}
+
+	if (result) {
+		for (const auto* child : S->children()) {
+			if (child != nullptr && !isFoldCandidate(child)) {
+				result = false;
+				break;
+			}
+		}
+	}
+	foldCandidates[S] = result;
+	return result;
+}
+
+bool ExpressionPrinter::mayFold(const Expr* E) {
+	if (!getTranslationOptions().foldConstants || getCurrentASTContext() == nullptr || E->isValueDependent() || E->isTypeDependent()) {
+		return false;
+	}
+
+	// literals are already folded, names of constants and enumerators are kept for readability
+	const auto* inner = E->IgnoreParenImpCasts();
+	if (isa<IntegerLiteral>(inner) || isa<FloatingLiteral>(inner) || isa<CXXBoolLiteralExpr>(inner) || isa<DeclRefExpr>(inner)) {
+		return false;
+	}
+	auto type = E->getType();
+	if (!type->isIntegralOrEnumerationType() && !type->isRealFloatingType()) {
+		return false;
+	}
+	return isFoldCandidate(E);
+}
+
+std::optional<Precedence> ExpressionPrinter::fold(const Expr* E) {
+	if (!mayFold(E)) {
+		return std::nullopt;
+	}
+
+	const auto* context = getCurrentASTContext();
+	Expr::EvalResult result;
+	auto lock = lockASTContext();
+	if (!E->EvaluateAsRValue(result, *context) || result.HasSideEffects) {
+		return std::nullopt;
+	}
+	// source manager fills its caches while reading, it is taken under the same lock
+	std::string comment;
+	if (getTranslationOptions().foldedSourceComments) {
+		comment = getSourceText(E, *context);
+	}
+	lock.unlock();
+
+	std::string literal;
+	if (result.Val.isInt() && E->getType()->isBooleanType()) {
+		literal = result.Val.getInt().getBoolValue() ? "True" : "False";
+	}
+	else if (result.Val.isInt()) {
+		literal = result.Val.getInt().toString(10);
+	}
+	else if (result.Val.isFloat()) {
+		literal = getFloatLiteral(result.Val.getFloat());
+	}
+	else {
+		return std::nullopt;
+	}
+
+	out << literal;
+	if (!comment.empty()) {
+		out << makeAnnotation(comment);
+	}
+	return literal[0] == '-' ? PREC_UNARY : PREC_ATOM;
+}
+
+void ExpressionPrinter::operand(const Expr* E, Precedence minPrecedence) {
+	size_t start = buffer.size();
+	auto known = getKnownPrecedence(E);
+	bool isParenthesized = known && *known < minPrecedence;
+	if (isParenthesized) {
+		out << "(";
+	}
+	auto precedence = print(E);
+	if (!isParenthesized && precedence < minPrecedence) {
+		// text of rule forms and literals is short, moving it is cheap
+		buffer.insert(buffer.begin() + start, '(');
+		isParenthesized = true;
+	}
+	if (isParenthesized) {
+		out << ")";
+	}
+}
+
+std::string ExpressionPrinter::operandText(const Expr* E, Precedence minPrecedence) {
+	size_t start = buffer.size();
+	operand(E, minPrecedence);
+	std::string text(buffer.begin() + start, buffer.end());
+	buffer.resize(start);
+	return text;
+}
+
+std::string ExpressionPrinter::takeText() {
+	std::string text(buffer.str());
+	buffer.clear();
+	return text;
+}
+
+void ExpressionPrinter::useAlias(size_t start) {
+	if (aliasScopes.empty()) {
+		return;
+	}
+	if (const auto* name = findAlias(buffer.str().substr(start))) {
+		buffer.resize(start);
+		out << *name;
+	}
+}
+
+std::optional<Precedence> ExpressionPrinter::getKnownPrecedence(const Expr* E) {
+	if (E == nullptr) {
+		return PREC_ATOM;
+	}
+	if (mayFold(E)) {
+		return std::nullopt;
+	}
+
+	if (const auto* C = dyn_cast<ConstantExpr>(E)) return getKnownPrecedence(C->getSubExpr());
+	if (const auto* C = dyn_cast<ExprWithCleanups>(E)) return getKnownPrecedence(C->getSubExpr());
+	if (const auto* L = dyn_cast<CXXStdInitializerListExpr>(E)) return getKnownPrecedence(L->getSubExpr());
+	if (const auto* M = dyn_cast<MaterializeTemporaryExpr>(E)) return getKnownPrecedence(M->getSubExpr());
+	if (const auto* P = dyn_cast<ParenExpr>(E)) return getKnownPrecedence(P->getSubExpr());
+	if (const auto* C = dyn_cast<ImplicitCastExpr>(E)) return getKnownPrecedence(C->getSubExpr());
+	if (const auto* D = dyn_cast<CXXDefaultInitExpr>(E)) return getKnownPrecedence(D->getExpr());
+
+	if (const auto* B = dyn_cast<BinaryOperator>(E)) {
+		if (B->getOpcode() == BO_Sub && B->getLHS()->getType()->isPointerType()) return std::nullopt;
+		return binaryOperators[B->getOpcode()].precedence;
+	}
+	if (const auto* U = dyn_cast<UnaryOperator>(E)) {
+		switch (U->getOpcode()) {
+		case UO_PostDec:
+		case UO_PreDec:
+		case UO_PostInc:
+		case UO_PreInc: return PREC_STATEMENT;
+		case UO_Deref: return std::nullopt;
+		case UO_Plus:
+		case UO_Minus:
+		case UO_Not:
+		case UO_LNot: return unaryOperators[U->getOpcode()].precedence;
+		default: return PREC_ATOM;
+		}
+	}
+	if (const auto* M = dyn_cast<CXXMemberCallExpr>(E)) {
+		const auto* method = M->getMethodDecl();
+		if (method != nullptr && method->getNameAsString() == "operator[]") return PREC_PRIMARY;
+		if (method == nullptr || getNumpyContainer(M->getImplicitObjectArgument()) != nullptr || findCallRule(method, M->getNumArgs()) != nullptr) {
+			return std::nullopt;
+		}
+		return PREC_PRIMARY;
+	}
+	if (const auto* C = dyn_cast<CallExpr>(E)) {
+		const auto* f = dyn_cast_or_null<FunctionDecl>(C->getCalleeDecl());
+		if (f == nullptr) return PREC_ATOM;
+		if (const auto* op = dyn_cast<CXXOperatorCallExpr>(C)) {
+			return op->getOperator() == OO_Star || op->getOperator() == OO_Minus ? std::nullopt : std::optional<Precedence>(PREC_PRIMARY);
+		}
+		return findCallRule(f, C->getNumArgs()) != nullptr ? std::nullopt : std::optional<Precedence>(PREC_PRIMARY);
+	}
+	if (isa<ConditionalOperator>(E)) return PREC_CONDITIONAL;
+	if (isa<MemberExpr>(E) || isa<CXXConstructExpr>(E) || isa<CXXFunctionalCastExpr>(E)) return PREC_PRIMARY;
+	if (isa<InitListExpr>(E) || isa<FloatingLiteral>(E) || isa<IntegerLiteral>(E) || isa<CXXBoolLiteralExpr>(E)
+		|| isa<DeclRefExpr>(E) || isa<CXXThisExpr>(E)) {
+		return PREC_ATOM;
+	}
+	return std::nullopt;
+}
+
+std::optional<Precedence> ExpressionPrinter::ruleCall(const CallRule& rule, const Expr* object, llvm::ArrayRef<const Expr*> args) {
+	bool isNumpy = isNumpyRule(rule, object, args);
+	llvm::StringRef form = isNumpy ? rule.numpy : rule.python;
+
+	auto getText = [&](const RulePlaceholder& p) -> std::optional<std::string> {
+		switch (p.kind) {
+		case RulePlaceholder::Object:
+			if (object == nullptr) return std::nullopt;
+			return operandText(object, PREC_PRIMARY);
+		case RulePlaceholder::Argument:
+			if (p.first >= args.size()) return std::nullopt;
+			return operandText(args[p.first], p.isDelimited ? PREC_LAMBDA : PREC_PRIMARY);
+		default:
+			if (p.first >= args.size() || p.last >= args.size()) return std::nullopt;
+			return sequence(args[p.first], args[p.last], p.kind == RulePlaceholder::Slice);
+		}
+	};
+
+	// callee of form is looked up in loop aliases as callee of ordinary call
+	std::string callee;
+	auto calleeLength = getFormCalleeLength(form);
+	if (calleeLength > 0) {
+		auto text = expandRuleForm(form.take_front(calleeLength), getText);
+		if (!text) return std::nullopt;
+		callee = getAlias(std::move(*text));
+	}
+	auto text = expandRuleForm(form.drop_front(calleeLength), getText);
+	if (!text) {
+		return std::nullopt;
+	}
+
+	if (calleeLength == 0 && object != nullptr) {
+		// len(v) of unchanged v
+		out << getAlias(std::move(*text));
+	}
+	else {
+		out << callee << *text;
+	}
+	return getFormPrecedence(form);
+}
+
+std::string ExpressionPrinter::callee(const CallExpr* C) {
+	const auto* f = C->getDirectCallee();
+	if (f == nullptr) {
+		return std::string();
+	}
+	const auto* member = dyn_cast<CXXMemberCallExpr>(C);
+	const Expr* object = member != nullptr ? member->getImplicitObjectArgument() : nullptr;
+
+	if (const auto* rule = findCallRule(f, C->getNumArgs())) {
+		llvm::StringRef form = isNumpyRule(*rule, object, llvm::makeArrayRef(C->getArgs(), C->getNumArgs())) ? rule->numpy : rule->python;
+		auto prefix = form.take_front(getFormCalleeLength(form));
+		if (prefix.consume_front("{self}")) {
+			return object != nullptr ? operandText(object, PREC_PRIMARY) + prefix.str() : std::string();
+		}
+		return prefix.str();
+	}
+	if (object != nullptr) {
+		return operandText(object, PREC_PRIMARY) + "." + f->getNameAsString();
+	}
+	return f->getNameAsString();
+}
+
+std::optional<Precedence> ExpressionPrinter::dereferencedRuleCall(const Expr* E) {
+	const auto* call = dyn_cast<CallExpr>(stripIterator(E));
+	if (call == nullptr || isa<CXXMemberCallExpr>(call) || isa<CXXOperatorCallExpr>(call)) {
+		return std::nullopt;
+	}
+	const auto* rule = findCallRule(call->getDirectCallee(), call->getNumArgs(), true);
+	if (rule == nullptr) {
+		return std::nullopt;
+	}
+	return ruleCall(*rule, nullptr, llvm::makeArrayRef(call->getArgs(), call->getNumArgs()));
+}
+
+std::optional<Precedence> ExpressionPrinter::iteratorDistance(const Expr* lhs, const Expr* rhs) {
+	const auto* call = dyn_cast<CallExpr>(stripIterator(lhs));
+	auto begin = getIteratorPosition(rhs);
+	if (call == nullptr || isa<CXXMemberCallExpr>(call) || isa<CXXOperatorCallExpr>(call) || !begin || begin->offset != nullptr || begin->isEnd) {
+		return std::nullopt;
+	}
+	const auto* rule = findIndexRule(call->getDirectCallee(), call->getNumArgs());
+	if (rule == nullptr || call->getNumArgs() == 0) {
+		return std::nullopt;
+	}
+
+	// index in range is index in container only if range starts at the same begin
+	auto first = getIteratorPosition(call->getArg(0));
+	if (!first || first->offset != nullptr || first->isEnd || operandText(first->container, PREC_PRIMARY) != operandText(begin->container, PREC_PRIMARY)) {
+		return std::nullopt;
+	}
+	return ruleCall(*rule, nullptr, llvm::makeArrayRef(call->getArgs(), call->getNumArgs()));
+}
+
+std::optional<std::string> ExpressionPrinter::sequence(const Expr* first, const Expr* last, bool isSlice) {
+	auto begin = getIteratorPosition(first);
+	auto end = getIteratorPosition(last);
+	if (!begin || !end || begin->isEnd) {
+		return std::nullopt;
+	}
+	auto container = operandText(begin->container, PREC_PRIMARY);
+	if (operandText(end->container, PREC_PRIMARY) != container) {
+		return std::nullopt;
+	}
+
+	if (begin->offset == nullptr && end->isEnd) {
+		return isSlice ? container + "[:]" : container;
+	}
+	auto from = begin->offset != nullptr ? operandText(begin->offset, PREC_LAMBDA) : std::string();
+	auto to = end->isEnd ? std::string() : end->offset != nullptr ? operandText(end->offset, PREC_LAMBDA) : std::string("0");
+	return container + "[" + from + ":" + to + "]";
+}
+
+Precedence ExpressionPrinter::VisitStmt(const Stmt* S) {
+	reportUnsupported(S);
+	out << "<unknown expression>";
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitConstantExpr(const ConstantExpr* C) {
+	return print(C->getSubExpr());
+}
+
+Precedence ExpressionPrinter::VisitExprWithCleanups(const ExprWithCleanups* E) {
+	return print(E->getSubExpr());
+}
+
+Precedence ExpressionPrinter::VisitCXXConstructExpr(const CXXConstructExpr* C) {
+	out << C->getConstructor()->getParent()->getNameAsString() << "(";
+	size_t idx = 0;
+	for (const auto* p : C->arguments()) {
+		if (p->isDefaultArgument()) {
+			continue;
+		}
+		out << (idx++ > 0 ? ", " : "");
+		operand(p, PREC_LAMBDA);
+	}
+	out << ")";
+	return PREC_PRIMARY;
+}
+
+Precedence ExpressionPrinter::VisitCXXStdInitializerListExpr(const CXXStdInitializerListExpr* L) {
+	return print(L->getSubExpr());
+}
+
+Precedence ExpressionPrinter::VisitMaterializeTemporaryExpr(const MaterializeTemporaryExpr* E) {
+	return print(E->getSubExpr());
+}
+
+Precedence ExpressionPrinter::VisitInitListExpr(const InitListExpr* L) {
+	out << "[";
+	for (size_t i = 0; i < L->getNumInits(); i++) {
+		out << (i > 0 ? ", " : "");
+		operand(L->getInit(i), PREC_LAMBDA);
+	}
+	out << "]";
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitParenExpr(const ParenExpr* E) {
+	// c++ parentheses are dropped, python ones are restored by precedence
+	return print(E->getSubExpr());
+}
+
+Precedence ExpressionPrinter::VisitUnaryOperator(const UnaryOperator* O) {
+	auto code = O->getOpcode();
+	switch (code)
+	{
+	case UO_PostDec:
+	case UO_PreDec:
+	case UO_PostInc:
+	case UO_PreInc: {
+		auto expr = operandText(O->getSubExpr(), PREC_PRIMARY);
+		out << expr << " = " << expr << (code == UO_PostInc || code == UO_PreInc ? " + 1" : " - 1");
+		return PREC_STATEMENT;
+	}
+	case UO_Deref:
+		if (auto call = dereferencedRuleCall(O->getSubExpr())) {
+			return *call;
+		}
+		out << "<unknown type of unary statement>";
+		return PREC_ATOM;
+	case UO_Plus:
+	case UO_Minus:
+	case UO_Not:
+	case UO_LNot: {
+		const auto& op = unaryOperators[code];
+		out << op.text;
+		operand(O->getSubExpr(), op.precedence);
+		return op.precedence;
+	}
 	default:
-		return { "<unknown type of unary statement>" , 1 };
-	}
-}
-
-ExprResult processCXXFunctionalCast(const CXXFunctionalCastExpr* E) {
-	auto subExpr = processExpr(E->getSubExpr());
-
-	auto type = E->getTypeInfoAsWritten()->getType().getAsString();
-	// c++ -> python type conversion
-	//@TODO fix
-	if (type == "double") type = "float";
-
-	return { type + "(" + subExpr + ")", 1 };
-}
-
-ExprResult processConditionalOperator(const ConditionalOperator* O) {
-	auto cond = processExpr(O->getCond());
-	auto trueExpr = processExpr(O->getTrueExpr());
-	auto falseExpr = processExpr(O->getFalseExpr());
-	return { trueExpr + " if " + cond + " else " + falseExpr , 1 };
-}
-
-ExprResult processLambdaExpression(const LambdaExpr* L) {
-	if (L->getBody()) {
-		StatementVisitor v(L->getBody());
-		auto body = v.getLines();
-
-		if (body.size() == 1) {
-			std::stringstream head;
-			head << "lambda ";
-			const auto* lambdaClass = L->getLambdaClass();
-			for (const auto* m : lambdaClass->methods()) {
-				auto name = m->getNameAsString();
-				
-				if (name == "operator()") {
-					size_t idx = 0;
-					for (const auto* p : m->parameters()) {
-						head << (idx++ > 0 ? "," : "") << p->getNameAsString();
-					}
-				}
-			}
-			head << ": ";
-
-			return { head.str() + *body.begin(), 1 };
-		}
-		else {
-			return { "<multiline_lambda>", 1 };
-		}
-	}
-}
-
-ExprResult processExprInt(const Expr* E) {
-	if (E == nullptr) {
-		return { "<null expression>", 1 };
-	}
-
-	if (isa<ConstantExpr>(E)) {
-		return processConstant(dyn_cast<ConstantExpr>(E));
-	}
-	if (isa<ExprWithCleanups>(E)) {
-		return processExprWithCleanups(dyn_cast<ExprWithCleanups>(E));
-	}
-	if (isa<CXXConstructExpr>(E)) {
-		return processCXXConstruct(dyn_cast<CXXConstructExpr>(E));
-	}
-	if (isa<CXXStdInitializerListExpr>(E)) {
-		return processCXXStdInitializerList(dyn_cast<CXXStdInitializerListExpr>(E));
-	}
-	if (isa<MaterializeTemporaryExpr>(E)) {
-		return processMaterializeTemporary(dyn_cast<MaterializeTemporaryExpr>(E));
-	}
-	if (isa<InitListExpr>(E)) {
-		return processInitList(dyn_cast<InitListExpr>(E));
-	}
-	if (isa<ParenExpr>(E)) {
-		return processParenExpr(dyn_cast<ParenExpr>(E));
-	}
-	if (isa<UnaryOperator>(E)) {
-		return processUnaryOperator(dyn_cast<UnaryOperator>(E));
-	}
-	if (isa<LambdaExpr>(E)) {
-		return processLambdaExpression(dyn_cast<LambdaExpr>(E));
-	}
-	if (const auto* b = dyn_cast<BinaryOperator>(E); b != nullptr) {
-		return processBinaryOperator(b);
-	}
-	if (isa<ImplicitCastExpr>(E)) {
-		return processImplicitCast(dyn_cast<ImplicitCastExpr>(E));
-	}
-	if (isa<ConditionalOperator>(E)) {
-		return processConditionalOperator(dyn_cast<ConditionalOperator>(E));
-	}
-	if (const auto* l = dyn_cast<FloatingLiteral>(E); l != nullptr) {
-		return processFloatingLiteral(l);
-	}
-	if (const auto* l = dyn_cast<IntegerLiteral>(E); l != nullptr) {
-		return processIntegerLiteral(l);
-	}
-	if (const auto* b = dyn_cast<CXXBoolLiteralExpr>(E); b != nullptr) {
-		return processBoolLiteral(b);
-	}
-	if (const auto* d = dyn_cast<DeclRefExpr>(E); d != nullptr) {
-		return  processDeclRef(d);
-	}
-	//      dyn_cast<>.        ,      .    isa<>
-	if (const auto* m = dyn_cast<CXXMemberCallExpr>(E); m != nullptr) {
-		return processMemberCall(m);
-	}
-	if (const auto* c = dyn_cast<CallExpr>(E); c != nullptr) {
-		return  processCall(c);
-	}
-	if (const auto* m = dyn_cast<MemberExpr>(E); m != nullptr) {
-		return processMember(m);
-	}
-	if (const auto* th = dyn_cast<CXXThisExpr>(E); th != nullptr) {
-		return processThis(th);
-	}
-	if (const auto* ie = dyn_cast<CXXDefaultInitExpr>(E); ie != nullptr) {
-		return processDefaultInit(ie);
-	}
-	if (isa<CXXFunctionalCastExpr>(E)) {
-		return processCXXFunctionalCast(dyn_cast<CXXFunctionalCastExpr>(E));
-	}
-
-	E->dumpColor();
-	return { "<unknown expression>", 1 };
-}
-
-std::string processExpr(const Expr* E) {
-	return processExprInt(E).first;
-}
-
-std::optional<ParsedBinaryExpr> getParsedBinaryExpr(const Expr* E)
-{
-	const auto* B = dyn_cast<BinaryOperator>(E);
-	if (B == nullptr) {
-		return std::nullopt;
-	}
-
-	auto code = B->getOpcode();
-	auto left = processExprInt(B->getLHS());
-	auto right = processExprInt(B->getRHS());
-
-	return ParsedBinaryExpr{ getExpResultAsStr(left, code), opcode2Str(code), getExpResultAsStr(right, code) };
-}
-
-std::optional<ParsedUnaryExpr> getParsedUnaryExpr(const Expr * E)
-{
-	const auto* B = dyn_cast<UnaryOperator>(E);
-	if (B == nullptr) {
-		return std::nullopt;
-	}
-
-	auto code = B->getOpcode();
-	auto expr = processExprInt(B->getSubExpr());
-
-	return ParsedUnaryExpr{ expr.first, opcode2Str(code) };
-}
+		out << "<unknown type of unary statement>";
+		return PREC_ATOM;
+	}
+}
+
+Precedence ExpressionPrinter::VisitLambdaExpr(const LambdaExpr* L) {
+	if (L->getBody() == nullptr) {
+		out << "<lambda without body>";
+		return PREC_ATOM;
+	}
+
+	StatementVisitor v(L->getBody());
+	auto body = v.takeLines();
+	if (body.size() != 1) {
+		out << "<multiline_lambda>";
+		return PREC_ATOM;
+	}
+
+	out << "lambda ";
+	const auto* lambdaClass = L->getLambdaClass();
+	for (const auto* m : lambdaClass->methods()) {
+		auto name = m->getNameAsString();
+
+		if (name == "operator()") {
+			size_t idx = 0;
+			for (const auto* p : m->parameters()) {
+				out << (idx++ > 0 ? "," : "") << p->getNameAsString();
+			}
+		}
+	}
+	auto line = body.front();
+	out << ": " << llvm::StringRef(line.data(), line.size());
+	return PREC_LAMBDA;
+}
+
+Precedence ExpressionPrinter::VisitBinaryOperator(const BinaryOperator* B) {
+	auto code = B->getOpcode();
+	const auto& op = binaryOperators[code];
+	if (code == BO_Sub && B->getLHS()->getType()->isPointerType()) {
+		if (auto index = iteratorDistance(B->getLHS(), B->getRHS())) {
+			return *index;
+		}
+	}
+
+	Precedence left, right;
+	if (op.precedence == PREC_STATEMENT) {
+		// python allows chained 'a = b = c', any other expression on the right is complete
+		bool isChain = (code == BO_Assign) && isa<BinaryOperator>(B->getRHS()->IgnoreParenImpCasts())
+			&& cast<BinaryOperator>(B->getRHS()->IgnoreParenImpCasts())->getOpcode() == BO_Assign;
+		left = PREC_PRIMARY;
+		right = isChain ? PREC_STATEMENT : PREC_LAMBDA;
+	}
+	else if (op.precedence == PREC_COMPARISON) {
+		// a < b < c means (a < b) and (b < c) in python
+		left = right = static_cast<Precedence>(PREC_COMPARISON + 1);
+	}
+	else {
+		// all remaining python binary operators are left-associative
+		left = op.precedence;
+		right = static_cast<Precedence>(op.precedence + 1);
+	}
+
+	operand(B->getLHS(), left);
+	out << " " << op.text << " ";
+	operand(B->getRHS(), right);
+	return op.precedence;
+}
+
+Precedence ExpressionPrinter::VisitImplicitCastExpr(const ImplicitCastExpr* E) {
+	//TODO check types
+	return print(E->getSubExpr());
+}
+
+Precedence ExpressionPrinter::VisitConditionalOperator(const ConditionalOperator* O) {
+	operand(O->getTrueExpr(), PREC_OR);
+	out << " if ";
+	operand(O->getCond(), PREC_OR);
+	out << " else ";
+	operand(O->getFalseExpr(), PREC_CONDITIONAL);
+	return PREC_CONDITIONAL;
+}
+
+Precedence ExpressionPrinter::VisitFloatingLiteral(const FloatingLiteral* F) {
+	out << getFloatLiteral(F->getValue());
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitIntegerLiteral(const IntegerLiteral* I) {
+	I->getValue().print(out, false);
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitCXXBoolLiteralExpr(const CXXBoolLiteralExpr* B) {
+	out << (B->getValue() ? "True" : "False");
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitDeclRefExpr(const DeclRefExpr* D) {
+	const auto* v = D->getDecl();
+	if (const auto* var = dyn_cast_or_null<VarDecl>(v)) {
+		out << getLocalName(var);
+	}
+	else if (v != nullptr) {
+		out << v->getDeclName();
+	}
+	else {
+		out << "<unknown variable>";
+	}
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitCallExpr(const CallExpr* C) {
+	const auto* f = dyn_cast_or_null<FunctionDecl>(C->getCalleeDecl());
+	if (f == nullptr) {
+		out << "<unknown call>";
+		return PREC_ATOM;
+	}
+
+	const auto* op = dyn_cast<CXXOperatorCallExpr>(C);
+	if (op != nullptr && op->getOperator() == OO_Star && C->getNumArgs() == 1) {
+		if (auto call = dereferencedRuleCall(C->getArg(0))) return *call;
+	}
+	if (op != nullptr && op->getOperator() == OO_Minus && C->getNumArgs() == 2) {
+		if (auto index = iteratorDistance(C->getArg(0), C->getArg(1))) return *index;
+	}
+	if (const auto* rule = op == nullptr ? findCallRule(f, C->getNumArgs()) : nullptr) {
+		if (auto call = ruleCall(*rule, nullptr, llvm::makeArrayRef(C->getArgs(), C->getNumArgs()))) return *call;
+	}
+
+	auto fName = f->getNameAsString();
+	if (fName == "operator[]") {
+		operand(C->getArg(0), PREC_PRIMARY);
+		out << "[";
+		operand(C->getArg(1), PREC_LAMBDA);
+		out << "]";
+	}
+	else if (fName == "operator()") {
+		operand(C->getArg(0), PREC_PRIMARY);
+		out << "(";
+		for (size_t i = 1; i < C->getNumArgs(); ++i) {
+			if (i > 1) out << ", ";
+			operand(C->getArg(i), PREC_LAMBDA);
+		}
+		out << ")";
+	}
+	else {
+		size_t start = buffer.size();
+		out << fName;
+		useAlias(start);
+		out << "(";
+		for (size_t i = 0; i < C->getNumArgs(); ++i) {
+			if (i > 0) out << ", ";
+			operand(C->getArg(i), PREC_LAMBDA);
+		}
+		out << ")";
+	}
+	return PREC_PRIMARY;
+}
+
+Precedence ExpressionPrinter::VisitMemberExpr(const MemberExpr* M) {
+	const auto* member = M->getMemberDecl();
+	const auto* object = M->getBase();
+
+	size_t start = buffer.size();
+	operand(object, PREC_PRIMARY);
+	out << "." << member->getDeclName();
+	useAlias(start);
+	return PREC_PRIMARY;
+}
+
+Precedence ExpressionPrinter::VisitCXXMemberCallExpr(const CXXMemberCallExpr* M) {
+	const auto* member = M->getMethodDecl();
+	const Expr* object = M->getImplicitObjectArgument();
+
+	auto mName = member->getNameAsString();
+	auto* container = getNumpyContainer(object);
+	if (mName == "operator[]") {
+		operand(M->getArg(0), PREC_PRIMARY);
+		out << "[";
+		operand(M->getArg(1), PREC_LAMBDA);
+		out << "]";
+		return PREC_PRIMARY;
+	}
+	if (container != nullptr && mName == "resize" && M->getNumArgs() == 1) {
+		// new elements are zeros as in vector
+		operand(object, PREC_PRIMARY);
+		out << ".resize(";
+		operand(M->getArg(0), PREC_LAMBDA);
+		out << ", refcheck=False)";
+		return PREC_PRIMARY;
+	}
+	if (container != nullptr && mName == "reserve") {
+		out << "pass";
+		return PREC_STATEMENT;
+	}
+	if (container != nullptr && M == container->fill) {
+		auto name = operandText(object, PREC_PRIMARY);
+		auto value = operandText(M->getArg(0), PREC_LAMBDA);
+		// array is preallocated by ascending counted fill loop, see findFillLoop
+		assert(!container->fillIndex.empty() && "fill is translated outside of its loop");
+		out << name << "[" << container->fillIndex << "] = " << value;
+		return PREC_STATEMENT;
+	}
+	if (const auto* rule = findCallRule(member, M->getNumArgs())) {
+		if (auto call = ruleCall(*rule, object, llvm::makeArrayRef(M->getArgs(), M->getNumArgs()))) {
+			return *call;
+		}
+	}
+
+	size_t start = buffer.size();
+	operand(object, PREC_PRIMARY);
+	out << "." << mName;
+	useAlias(start);
+	out << "(";
+
+	size_t idx = 0;
+	for (const auto* p : M->arguments()) {
+		out << (idx++ > 0 ? ", " : "");
+		operand(p, PREC_LAMBDA);
+	}
+	out << ")";
+	return PREC_PRIMARY;
+}
+
+Precedence ExpressionPrinter::VisitCXXThisExpr(const CXXThisExpr* Th) {
+	out << "self";
+	return PREC_ATOM;
+}
+
+Precedence ExpressionPrinter::VisitCXXDefaultInitExpr(const CXXDefaultInitExpr* Ie) {
+	return print(Ie->getExpr());
+}
+
+Precedence ExpressionPrinter::VisitCXXFunctionalCastExpr(const CXXFunctionalCastExpr* E) {
+	auto type = E->getTypeInfoAsWritten()->getType().getAsString();
+	// c++ -> python type conversion
+	//@TODO fix
+	if (type == "double") type = "float";
+
+	out << type << "(";
+	operand(E->getSubExpr(), PREC_LAMBDA);
+	out << ")";
+	return PREC_PRIMARY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string processExpr(const Expr* E) {
+	PhaseScope phase(Phase::Expressions);
+	ExpressionPrinter printer;
+	printer.print(E);
+	return printer.takeText();
+}
+
+std::string processAdditiveOperand(const Expr* E) {
+	PhaseScope phase(Phase::Expressions);
+	return ExpressionPrinter().operandText(E, PREC_ADDITIVE);
+}
+
+ExpressionAliasScope::ExpressionAliasScope(const std::vector<const Expr*>& invariants) {
+	PhaseScope phase(Phase::Expressions);
+	for (const auto* E : invariants) {
+		// same text as printer produces at the place of alias lookup
+		ExpressionPrinter printer;
+		std::string text;
+		const auto* member = dyn_cast<CXXMemberCallExpr>(E);
+		if (member != nullptr && member->getMethodDecl() != nullptr && member->getMethodDecl()->getName() == "size" && member->getNumArgs() == 0) {
+			// len(v)
+			printer.print(E);
+			text = printer.takeText();
+		}
+		else if (const auto* call = dyn_cast<CallExpr>(E)) {
+			text = printer.callee(call);
+		}
+		else if (isa<MemberExpr>(E)) {
+			printer.print(E);
+			text = printer.takeText();
+		}
+		if (text.empty() || index.count(text)) {
+			continue;
+		}
+
+		// python identifier from text: 'self.a.b' -> '_self_a_b', 'len(v)' -> '_len_v'
+		std::string name = "_";
+		for (char c : text) {
+			if (isalnum(static_cast<unsigned char>(c))) name += c;
+			else if (name.back() != '_') name += '_';
+		}
+		while (name.size() > 1 && name.back() == '_') name.pop_back();
+		// text is already alias of outer loop
+		if (name == text) {
+			continue;
+		}
+		auto isTaken = [this](const std::string& n) {
+			for (const auto* scope : aliasScopes) {
+				for (const auto& a : scope->aliases) if (a.name == n) return true;
+			}
+			for (const auto& a : aliases) if (a.name == n) return true;
+			return false;
+		};
+		auto unique = name;
+		for (int i = 2; isTaken(unique); i++) {
+			unique = name + std::to_string(i);
+		}
+
+		index[text] = aliases.size();
+		aliases.push_back({ unique, text });
+	}
+	aliasScopes.push_back(this);
+}
+
+ExpressionAliasScope::~ExpressionAliasScope() {
+	aliasScopes.pop_back();
+}
+
+LineBuffer ExpressionAliasScope::takeAliasLines() const {
+	LineBuffer lines;
+	for (const auto& a : aliases) {
+		if (a.isUsed) {
+			lines.push_back(a.name + " = " + a.text);
+		}
+	}
+	return lines;
+}
+
+const std::string* ExpressionAliasScope::find(llvm::StringRef text) {
+	auto it = index.find(text);
+	if (it == index.end()) {
+		return nullptr;
+	}
+	auto& alias = aliases[it->second];
+	alias.isUsed = true;
+	return &alias.name;
+}
+
+// innermost active scope
+static thread_local LocalNameScope* localNames = nullptr;
+
+LocalNameScope::LocalNameScope(llvm::DenseMap<const VarDecl*, std::string> names)
+	: names(std::move(names)), previous(localNames) {
+	localNames = this;
+}
+
+LocalNameScope::~LocalNameScope() {
+	localNames = previous;
+}
+
+std::string getLocalName(const VarDecl* D) {
+	for (const auto* scope = localNames; scope != nullptr; scope = scope->previous) {
+		auto it = scope->names.find(D);
+		if (it != scope->names.end()) {
+			return it->second;
+		}
+	}
+	return D->getNameAsString();
+}
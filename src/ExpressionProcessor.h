@@ -1,16 +1,58 @@
-#include "clang/AST/Expr.h"
-#include <string>
-#include <optional>
-
-using namespace clang;
-
-// get python string from given expression. No multiline formating
-std::string processExpr(const Expr* E);
-
-// get L(R)HS and opcode as strings for BinaryOperator
-typedef std::tuple<std::string, std::string, std::string> ParsedBinaryExpr;
-std::optional<ParsedBinaryExpr> getParsedBinaryExpr(const Expr* E);
-
-// get L(R)HS and opcode as strings for UnaryOperator
-typedef std::tuple<std::string, std::string> ParsedUnaryExpr;
-std::optional<ParsedUnaryExpr> getParsedUnaryExpr(const Expr* E);
\ No newline at end of file
+#pragma once
+#include "clang/AST/Expr.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "Lines.h"
+#include <string>
+#include <optional>
+#include <vector>
+
+using namespace clang;
+
+// get python string from given expression. No multiline formating
+std::string processExpr(const Expr* E);
+
+// get python string of expression used as operand of '+' or '-', parenthesized if needed
+std::string processAdditiveOperand(const Expr* E);
+
+// loop invariants (see findLoopInvariants) are printed as local names while scope is active,
+// caller writes their assignments before loop. Scopes of nested loops are searched innermost first
+class ExpressionAliasScope {
+public:
+	explicit ExpressionAliasScope(const std::vector<const Expr*>& invariants);
+	~ExpressionAliasScope();
+	ExpressionAliasScope(const ExpressionAliasScope&) = delete;
+	ExpressionAliasScope& operator=(const ExpressionAliasScope&) = delete;
+
+	// 'name = expression' of every alias used by expressions printed in scope
+	LineBuffer takeAliasLines() const;
+	// local name of python expression, nullptr if it has no alias
+	const std::string* find(llvm::StringRef text);
+private:
+	struct Alias {
+		std::string name;
+		std::string text;
+		bool isUsed = false;
+	};
+	std::vector<Alias> aliases;
+	// printed text -> index in aliases
+	llvm::StringMap<size_t> index;
+};
+
+// locals printed under other name while scope is active, e.g. cython cdef local which clashes with
+// parameter of function. Declarations and references of variable use getLocalName
+class LocalNameScope {
+public:
+	explicit LocalNameScope(llvm::DenseMap<const VarDecl*, std::string> names);
+	~LocalNameScope();
+	LocalNameScope(const LocalNameScope&) = delete;
+	LocalNameScope& operator=(const LocalNameScope&) = delete;
+private:
+	llvm::DenseMap<const VarDecl*, std::string> names;
+	LocalNameScope* previous;
+
+	friend std::string getLocalName(const VarDecl* D);
+};
+
+// python name of variable
+std::string getLocalName(const VarDecl* D);
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "HeaderFilter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+HeaderFilter::HeaderFilter(const SourceManager& SM, const TranslationOptions& options)
+	: SM(SM) {
+	if (!options.headerFilter.empty()) {
+		regex.emplace(options.headerFilter);
+	}
+	for (const auto& d : options.translateDirs) {
+		llvm::SmallString<256> dir(d);
+		llvm::sys::fs::make_absolute(dir);
+		llvm::sys::path::remove_dots(dir, true);
+		dirs.push_back(std::string(dir.str()));
+	}
+}
+
+bool HeaderFilter::isPathTranslated(llvm::StringRef path) const {
+	if (!regex && dirs.empty()) {
+		return true;
+	}
+	if (regex && regex->match(path)) {
+		return true;
+	}
+	for (const auto& d : dirs) {
+		if (path.startswith(d) && (path.size() == d.size() || llvm::sys::path::is_separator(path[d.size()]))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HeaderFilter::isTranslated(SourceLocation Loc) {
+	if (Loc.isInvalid()) {
+		return false;
+	}
+
+	Loc = SM.getExpansionLoc(Loc);
+	auto id = SM.getFileID(Loc);
+	auto it = files.find(id);
+	if (it != files.end()) {
+		return it->second;
+	}
+
+	bool isTranslated = false;
+	if (id == SM.getMainFileID()) {
+		isTranslated = true;
+	}
+	else if (!SM.isInSystemHeader(Loc)) {
+		if (const auto* file = SM.getFileEntryForID(id)) {
+			auto path = file->tryGetRealPathName();
+			isTranslated = isPathTranslated(path.empty() ? file->getName() : path);
+		}
+	}
+	files[id] = isTranslated;
+	return isTranslated;
+}
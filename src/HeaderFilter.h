@@ -0,0 +1,26 @@
+#pragma once
+#include "TranslationOptions.h"
+
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Regex.h"
+
+#include <optional>
+
+using namespace clang;
+
+// decides which declarations of TU are translated: main file and user headers accepted
+// by --header-filter / --translate-dir. Result is computed once per file
+class HeaderFilter {
+public:
+	HeaderFilter(const SourceManager& SM, const TranslationOptions& options);
+
+	bool isTranslated(SourceLocation Loc);
+private:
+	const SourceManager& SM;
+	std::optional<llvm::Regex> regex;
+	std::vector<std::string> dirs;
+	llvm::DenseMap<FileID, bool> files;
+
+	bool isPathTranslated(llvm::StringRef path) const;
+};
@@ -0,0 +1,154 @@
+#include "HeaderModules.h"
+#include "TranslationOptions.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// header path as written in comments: relative to current directory when it is inside it
+static std::string getDisplayPath(llvm::StringRef headerPath) {
+	std::error_code ec;
+	auto path = fs::path(headerPath.str());
+	auto relative = path.lexically_relative(fs::current_path(ec));
+	if (ec || relative.empty() || *relative.begin() == "..") {
+		return path.generic_string();
+	}
+	return relative.generic_string();
+}
+
+HeaderModuleRegistry::HeaderModuleRegistry(std::string directory)
+	: directory(std::move(directory)) {
+	if (!this->directory.empty()) {
+		llvm::sys::fs::create_directories(this->directory);
+	}
+}
+
+// name made of path alone, several headers may get the same one
+static std::string getBaseModuleName(llvm::StringRef displayPath) {
+	std::string name;
+	for (char c : displayPath) {
+		if (isalnum(static_cast<unsigned char>(c))) name += c;
+		else if (!name.empty() && name.back() != '_') name += '_';
+	}
+	if (name.empty() || isdigit(static_cast<unsigned char>(name.front()))) {
+		name.insert(0, "_");
+	}
+	return name;
+}
+
+std::string HeaderModuleRegistry::getModuleName(llvm::StringRef headerPath) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return getModuleNameLocked(getDisplayPath(headerPath));
+}
+
+std::string HeaderModuleRegistry::getModuleNameLocked(const std::string& displayPath) {
+	if (auto it = names.find(displayPath); it != names.end()) {
+		return it->second;
+	}
+	// suffix is hash of path, not counter, so it does not depend on number of colliding headers
+	auto base = getBaseModuleName(displayPath);
+	auto name = base;
+	for (unsigned i = 0; headers.count(name) != 0; i++) {
+		auto hash = llvm::xxHash64(displayPath + (i > 0 ? std::to_string(i) : std::string()));
+		name = base + "_" + llvm::utohexstr(hash & 0xffffffff, true);
+	}
+	names[displayPath] = name;
+	headers[name] = displayPath;
+	return name;
+}
+
+std::string HeaderModuleRegistry::getModulePath(llvm::StringRef moduleName) const {
+	llvm::SmallString<256> path(directory);
+	// cython modules are .pyx like main outputs, so they are compiled instead of imported as python
+	llvm::sys::path::append(path, moduleName + getTranslationOptions().getOutputExtension());
+	return std::string(path.str());
+}
+
+bool HeaderModuleRegistry::claim(llvm::StringRef headerPath, uint64_t contentHash) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto [it, isNew] = claimed.try_emplace(headerPath, contentHash);
+	if (isNew) {
+		return true;
+	}
+	// header was edited since its module was written, e.g. while server runs
+	if (it->second == contentHash) {
+		return false;
+	}
+	it->second = contentHash;
+	return true;
+}
+
+bool HeaderModuleRegistry::hasImportedModules(llvm::StringRef python) {
+	std::lock_guard<std::mutex> lock(mutex);
+	llvm::SmallVector<llvm::StringRef, 64> lines;
+	python.split(lines, '\n');
+	for (auto line : lines) {
+		// header imports are the only ones followed by comment with path of header
+		auto comment = line.find("  # ");
+		if (!line.startswith("from ") || comment == llvm::StringRef::npos) {
+			continue;
+		}
+		auto module = line.drop_front(5).take_until([](char c) { return c == ' '; });
+		auto displayPath = line.substr(comment + 4).rtrim().str();
+		// name may be given to other header of this run when names collide
+		auto it = names.find(displayPath);
+		if (it != names.end() ? it->second != module : headers.count(module) != 0) {
+			return false;
+		}
+		names[displayPath] = module.str();
+		headers[module] = displayPath;
+		if (!llvm::sys::fs::exists(getModulePath(module))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// python names defined by top-level declaration, see DeclarationVisitor
+static void collectNames(const Decl* D, std::vector<std::string>& names, llvm::StringSet<>& seen) {
+	auto add = [&](const NamedDecl* N) {
+		if (N->getIdentifier() != nullptr && seen.insert(N->getName()).second) {
+			names.push_back(N->getNameAsString());
+		}
+	};
+
+	if (const auto* E = dyn_cast<EnumDecl>(D)) {
+		for (const auto* i : E->enumerators()) {
+			add(i);
+		}
+	}
+	else if (const auto* R = dyn_cast<CXXRecordDecl>(D)) {
+		if (R->isThisDeclarationADefinition() && (R->isStruct() || R->isClass())) add(R);
+	}
+	else if (const auto* V = dyn_cast<VarDecl>(D)) {
+		// out-of-line definitions of class members and extern declarations are not module names
+		if (!V->isStaticDataMember() && V->isThisDeclarationADefinition() != VarDecl::DeclarationOnly) add(V);
+	}
+	else if (const auto* F = dyn_cast<FunctionDecl>(D)) {
+		// prototype is translated to comment, function is defined by unit which has its body
+		if (!isa<CXXMethodDecl>(F) && F->doesThisDeclarationHaveABody()) add(F);
+	}
+}
+
+std::string HeaderModuleRegistry::getHeaderImport(llvm::StringRef headerPath, llvm::ArrayRef<const Decl*> decls) {
+	std::vector<std::string> names;
+	llvm::StringSet<> seen;
+	for (const auto* d : decls) {
+		collectNames(d, names, seen);
+	}
+	if (names.empty()) {
+		return std::string();
+	}
+
+	std::string line = "from " + getModuleName(headerPath) + " import ";
+	for (size_t i = 0; i < names.size(); i++) {
+		line += (i > 0 ? ", " : "") + names[i];
+	}
+	return line + "  # " + getDisplayPath(headerPath);
+}
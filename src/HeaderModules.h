@@ -0,0 +1,44 @@
+#pragma once
+#include "clang/AST/DeclCXX.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+// declarations of user headers are translated once per run into python modules of their own
+// (--header-modules). Units which include header import its names instead of emitting own copies
+class HeaderModuleRegistry {
+public:
+	// modules are written to directory, current directory if it is empty
+	explicit HeaderModuleRegistry(std::string directory);
+
+	// python module of header: path relative to current directory with '_' instead of
+	// separators and dots, 'include/vec.h' -> 'include_vec_h'. Header whose name is already
+	// taken by other one ('include_vec/h') gets hash of its path as suffix
+	std::string getModuleName(llvm::StringRef headerPath);
+	std::string getModulePath(llvm::StringRef moduleName) const;
+
+	// true for the first unit which asks for header and for unit which sees changed content
+	// of header, it writes module of header
+	bool claim(llvm::StringRef headerPath, uint64_t contentHash);
+	// every header module imported by python code exists and belongs to the same header in this run.
+	// Cached translation is stale otherwise. Names of its modules are reserved for their headers
+	bool hasImportedModules(llvm::StringRef python);
+
+	// 'from include_vec_h import Vec, length  # include/vec.h' for top-level declarations of header,
+	// empty if they define no python names
+	std::string getHeaderImport(llvm::StringRef headerPath, llvm::ArrayRef<const Decl*> decls);
+private:
+	std::string directory;
+	std::mutex mutex;
+	llvm::StringMap<uint64_t> claimed;
+	// display path of header -> module name and back
+	llvm::StringMap<std::string> names;
+	llvm::StringMap<std::string> headers;
+
+	std::string getModuleNameLocked(const std::string& displayPath);
+};
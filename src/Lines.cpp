@@ -1,26 +1,131 @@
-#include "Lines.h"
-#include <iostream>
-
-void shiftLines(std::list<std::string>& lines) {
-	for (auto& s : lines) s = std::string("\t") + s;
-}
-
-LinesList& commentLines(LinesList& lines) {
-	for (auto& s : lines) s = std::string("# ") + s;
-	return lines;
-}
-
-std::list<std::string>& shiftLinesRet(std::list<std::string>& lines) {
-	shiftLines(lines);
-	return lines;
-}
-
-void printLines(const std::list<std::string>& lines) {
-	for (const auto& s : lines) {
-		std::cout << s << "\n";
-	}
-}
-
-void addLines(std::list<std::string>& lines, const std::list<std::string>& addedLines) {
-	lines.insert(lines.end(), addedLines.begin(), addedLines.end());
-}
\ No newline at end of file
+#include "Lines.h"
+#include <algorithm>
+
+// small blocks are copied to own arena instead of allocating node for them
+static const size_t inlineBlockLines = 4;
+
+// encloses annotation in text of line, source text of c++ never contains it
+static const char annotationMark = '\x1e';
+
+std::string makeAnnotation(std::string_view comment) {
+	std::string text(1, annotationMark);
+	text.append(comment);
+	text += annotationMark;
+	return text;
+}
+
+LineBuffer::LineBuffer(std::initializer_list<std::string_view> lines) {
+	for (auto s : lines) push_back(s);
+}
+
+void LineBuffer::push_back(std::string_view line) {
+	size_t start = text.size();
+	if (line.find(annotationMark) == std::string_view::npos) {
+		text.append(line);
+	}
+	else {
+		// code first, annotations in order of their expressions
+		std::string comment;
+		while (true) {
+			auto open = line.find(annotationMark);
+			text.append(line.substr(0, open));
+			if (open == std::string_view::npos) break;
+
+			auto close = line.find(annotationMark, open + 1);
+			comment += comment.empty() ? "  # " : "; ";
+			comment.append(line.substr(open + 1, close == std::string_view::npos ? close : close - open - 1));
+			if (close == std::string_view::npos) break;
+			line.remove_prefix(close + 1);
+		}
+		text.append(comment);
+	}
+	entries.push_back({ -shift, start, text.size() - start, nullptr });
+	count++;
+}
+
+void LineBuffer::append(LineBuffer&& block) {
+	if (block.empty()) {
+		return;
+	}
+	if (empty()) {
+		*this = std::move(block);
+		return;
+	}
+
+	auto blockCount = block.count;
+	bool isFlat = block.entries.size() <= inlineBlockLines;
+	for (const auto& e : block.entries) isFlat &= (e.block == nullptr);
+
+	if (isFlat) {
+		for (const auto& e : block.entries) {
+			entries.push_back({ e.indent + block.shift - shift, text.size(), e.length, nullptr });
+			text.append(block.text, e.offset, e.length);
+		}
+	}
+	else {
+		Entry e;
+		e.indent = -shift;
+		e.block = std::make_unique<LineBuffer>(std::move(block));
+		entries.push_back(std::move(e));
+	}
+	count += blockCount;
+	block.clear();
+}
+
+void LineBuffer::indent() {
+	shift++;
+}
+
+void LineBuffer::clear() {
+	text.clear();
+	entries.clear();
+	shift = 0;
+	count = 0;
+}
+
+std::string_view LineBuffer::front() const {
+	for (const auto& e : entries) {
+		if (e.block == nullptr) {
+			return std::string_view(text).substr(e.offset, e.length);
+		}
+		if (!e.block->empty()) {
+			return e.block->front();
+		}
+	}
+	return {};
+}
+
+void LineBuffer::write(OutputSink& out, int baseIndent) const {
+	static const std::string tabs(64, '\t');
+	for (const auto& e : entries) {
+		int level = baseIndent + shift + e.indent;
+		if (e.block != nullptr) {
+			e.block->write(out, level);
+			continue;
+		}
+		for (int i = level; i > 0; i -= static_cast<int>(tabs.size())) {
+			out.write(tabs.data(), std::min<int>(i, static_cast<int>(tabs.size())));
+		}
+		out.write(text.data() + e.offset, e.length);
+		out << '\n';
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void shiftLines(LineBuffer& lines) {
+	lines.indent();
+}
+
+LineBuffer shiftLinesRet(LineBuffer&& lines) {
+	lines.indent();
+	return std::move(lines);
+}
+
+void printLines(const LineBuffer& lines, OutputSink& out) {
+	lines.write(out);
+}
+
+void addLines(LineBuffer& lines, LineBuffer&& addedLines) {
+	lines.append(std::move(addedLines));
+}
@@ -1,10 +1,58 @@
-#include <list>
-#include <string>
-
-typedef std::list<std::string> LinesList;
-
-void shiftLines(std::list<std::string>& lines);
-std::list<std::string>& shiftLinesRet(std::list<std::string>& lines);
-LinesList& commentLines(LinesList& lines);
-void printLines(const std::list<std::string>& lines);
-void addLines(std::list<std::string>& lines, const std::list<std::string>& addedLines);
\ No newline at end of file
+#pragma once
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "OutputSink.h"
+
+// python lines with indent levels. Own lines are stored in one text arena, child blocks are attached
+// by pointer: indenting a buffer and appending a block are O(1) and never touch the text.
+// Tabs are produced only by write()
+class LineBuffer {
+public:
+	LineBuffer() = default;
+	LineBuffer(std::initializer_list<std::string_view> lines);
+	LineBuffer(LineBuffer&&) = default;
+	LineBuffer& operator=(LineBuffer&&) = default;
+
+	void push_back(std::string_view line);
+	// move lines of block to the end of buffer
+	void append(LineBuffer&& block);
+	// shift lines which are already in buffer one level right
+	void indent();
+	void clear();
+
+	bool empty() const { return count == 0; }
+	size_t size() const { return count; }
+	// text of the first line without indent
+	std::string_view front() const;
+
+	void write(OutputSink& out, int baseIndent = 0) const;
+private:
+	struct Entry {
+		// indent relative to buffer, stored without current shift
+		int indent = 0;
+		size_t offset = 0;
+		size_t length = 0;
+		// nested block, null for own line
+		std::unique_ptr<LineBuffer> block;
+	};
+
+	std::string text;
+	std::vector<Entry> entries;
+	// added to indent of every entry
+	int shift = 0;
+	size_t count = 0;
+};
+
+// comment carried inside of expression text, for notes which have no place in python expression.
+// push_back moves annotations of line to comment at its end, so they stay with their expression
+// and text which is dropped (failed vectorization, ...) drops its annotations too
+std::string makeAnnotation(std::string_view comment);
+
+void shiftLines(LineBuffer& lines);
+LineBuffer shiftLinesRet(LineBuffer&& lines);
+void printLines(const LineBuffer& lines, OutputSink& out);
+void addLines(LineBuffer& lines, LineBuffer&& addedLines);
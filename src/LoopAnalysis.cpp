@@ -0,0 +1,743 @@
+#include "LoopAnalysis.h"
+#include "CallRules.h"
+#include "ContainerLowering.h"
+#include "ExpressionProcessor.h"
+#include "TranslationContext.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+
+namespace {
+
+// variables and fields changed by statement
+struct Writes {
+	llvm::DenseSet<const ValueDecl*> decls;
+	// non-const method of 'this' is called, any field may change
+	bool isThisWritten = false;
+	// call of user function, it may change globals, statics and objects behind pointers and references
+	bool hasOpaqueCall = false;
+};
+
+// callee of std library does not change user variables except its arguments
+bool isOpaqueCall(const FunctionDecl* F) {
+	return F == nullptr || !F->isInStdNamespace();
+}
+
+// variable or field which is changed by writing to 'a', 'a.b', 'a[i]', '*a'
+const ValueDecl* getWrittenDecl(const Expr* E) {
+	E = E->IgnoreParenImpCasts();
+	if (const auto* ref = dyn_cast<DeclRefExpr>(E)) {
+		return ref->getDecl();
+	}
+	if (const auto* member = dyn_cast<MemberExpr>(E)) {
+		if (isa<CXXThisExpr>(member->getBase()->IgnoreParenImpCasts())) {
+			return member->getMemberDecl();
+		}
+		return getWrittenDecl(member->getBase());
+	}
+	if (const auto* subscript = dyn_cast<ArraySubscriptExpr>(E)) {
+		return getWrittenDecl(subscript->getBase());
+	}
+	if (const auto* op = dyn_cast<CXXOperatorCallExpr>(E)) {
+		if (op->getOperator() == OO_Subscript || op->getOperator() == OO_Star) {
+			return getWrittenDecl(op->getArg(0));
+		}
+	}
+	if (const auto* unary = dyn_cast<UnaryOperator>(E)) {
+		if (unary->getOpcode() == UO_Deref) {
+			return getWrittenDecl(unary->getSubExpr());
+		}
+	}
+	return nullptr;
+}
+
+void addWrite(const Expr* E, Writes& writes) {
+	if (isa<CXXThisExpr>(E->IgnoreParenImpCasts())) {
+		writes.isThisWritten = true;
+	}
+	else if (const auto* decl = getWrittenDecl(E)) {
+		writes.decls.insert(decl);
+	}
+}
+
+void collectWrites(const Stmt* S, Writes& writes) {
+	if (S == nullptr) {
+		return;
+	}
+
+	if (const auto* binary = dyn_cast<BinaryOperator>(S)) {
+		if (binary->isAssignmentOp()) addWrite(binary->getLHS(), writes);
+	}
+	else if (const auto* unary = dyn_cast<UnaryOperator>(S)) {
+		// address may be used for writing
+		if (unary->isIncrementDecrementOp() || unary->getOpcode() == UO_AddrOf) addWrite(unary->getSubExpr(), writes);
+	}
+	else if (const auto* member = dyn_cast<CXXMemberCallExpr>(S)) {
+		const auto* method = member->getMethodDecl();
+		if (method == nullptr || !method->isConst()) addWrite(member->getImplicitObjectArgument(), writes);
+		writes.hasOpaqueCall |= isOpaqueCall(method);
+	}
+	else if (const auto* op = dyn_cast<CXXOperatorCallExpr>(S)) {
+		const auto* method = dyn_cast_or_null<CXXMethodDecl>(op->getDirectCallee());
+		writes.hasOpaqueCall |= isOpaqueCall(op->getDirectCallee());
+		if (op->isAssignmentOp() || op->getOperator() == OO_PlusPlus || op->getOperator() == OO_MinusMinus
+			|| (method != nullptr && !method->isConst())) {
+			addWrite(op->getArg(0), writes);
+		}
+	}
+	else if (const auto* call = dyn_cast<CallExpr>(S)) {
+		const auto* f = call->getDirectCallee();
+		writes.hasOpaqueCall |= isOpaqueCall(f);
+		for (unsigned i = 0; i < call->getNumArgs(); i++) {
+			// arguments bound to non-const references may be changed by callee
+			QualType type = f != nullptr && i < f->getNumParams() ? f->getParamDecl(i)->getType() : QualType();
+			if (type.isNull() || (type->isReferenceType() && !type.getNonReferenceType().isConstQualified())) {
+				addWrite(call->getArg(i), writes);
+			}
+		}
+	}
+	else if (const auto* construct = dyn_cast<CXXConstructExpr>(S)) {
+		const auto* constructor = construct->getConstructor();
+		writes.hasOpaqueCall |= constructor != nullptr && constructor->isUserProvided() && isOpaqueCall(constructor);
+	}
+	else if (const auto* decl = dyn_cast<DeclStmt>(S)) {
+		// non-const reference is an alias for writing
+		for (const auto* d : decl->decls()) {
+			const auto* vd = dyn_cast<VarDecl>(d);
+			if (vd != nullptr && vd->getType()->isReferenceType() && !vd->getType().getNonReferenceType().isConstQualified()
+				&& vd->getInit() != nullptr) {
+				addWrite(vd->getInit(), writes);
+			}
+		}
+	}
+
+	for (const auto* child : S->children()) {
+		collectWrites(child, writes);
+	}
+}
+
+// value which is not owned by function: global or static variable, object behind reference,
+// pointer or 'this'. Any opaque call may change it
+bool isNonLocal(const Stmt* S) {
+	if (const auto* ref = dyn_cast<DeclRefExpr>(S)) {
+		const auto* var = dyn_cast<VarDecl>(ref->getDecl());
+		return var != nullptr && (var->hasGlobalStorage() || var->getType()->isReferenceType());
+	}
+	if (const auto* member = dyn_cast<MemberExpr>(S)) {
+		return member->isArrow() || isa<CXXThisExpr>(member->getBase()->IgnoreParenImpCasts());
+	}
+	if (const auto* unary = dyn_cast<UnaryOperator>(S)) {
+		return unary->getOpcode() == UO_Deref;
+	}
+	if (const auto* subscript = dyn_cast<ArraySubscriptExpr>(S)) {
+		return subscript->getBase()->getType()->isPointerType();
+	}
+	return false;
+}
+
+// bound is evaluated once by range(), so it must give the same value on every iteration
+bool isInvariant(const Stmt* S, const Writes& writes) {
+	if (S == nullptr) {
+		return true;
+	}
+	if (writes.hasOpaqueCall && isNonLocal(S)) {
+		return false;
+	}
+
+	if (const auto* ref = dyn_cast<DeclRefExpr>(S)) {
+		if (writes.decls.count(ref->getDecl())) return false;
+	}
+	else if (const auto* member = dyn_cast<MemberExpr>(S)) {
+		if (writes.decls.count(member->getMemberDecl())) return false;
+		if (writes.isThisWritten && isa<CXXThisExpr>(member->getBase()->IgnoreParenImpCasts())) return false;
+	}
+	else if (const auto* call = dyn_cast<CXXMemberCallExpr>(S)) {
+		// only observers like size()
+		const auto* method = call->getMethodDecl();
+		if (method == nullptr || !method->isConst()) return false;
+	}
+	else if (isa<CallExpr>(S)) {
+		return false;
+	}
+	else if (const auto* unary = dyn_cast<UnaryOperator>(S)) {
+		if (unary->isIncrementDecrementOp()) return false;
+	}
+	else if (const auto* binary = dyn_cast<BinaryOperator>(S)) {
+		if (binary->isAssignmentOp()) return false;
+	}
+
+	for (const auto* child : S->children()) {
+		if (!isInvariant(child, writes)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool isReferenceTo(const Expr* E, const VarDecl* D) {
+	const auto* ref = E != nullptr ? dyn_cast<DeclRefExpr>(E->IgnoreParenImpCasts()) : nullptr;
+	return ref != nullptr && ref->getDecl() == D;
+}
+
+std::optional<long long> evaluateInt(const Expr* E, const ASTContext& Context) {
+	Expr::EvalResult result;
+	auto lock = lockASTContext();
+	if (E->isValueDependent() || !E->EvaluateAsInt(result, Context)) {
+		return std::nullopt;
+	}
+	return result.Val.getInt().getExtValue();
+}
+
+// python text of 'E + offset', constants are folded
+std::string addOffset(const Expr* E, long long offset, const ASTContext& Context) {
+	if (auto value = evaluateInt(E, Context)) {
+		return std::to_string(*value + offset);
+	}
+	if (offset == 0) {
+		return processExpr(E);
+	}
+	return processAdditiveOperand(E) + (offset > 0 ? " + " : " - ") + std::to_string(offset > 0 ? offset : -offset);
+}
+
+// step of '++i', 'i--', 'i += k', 'i -= k', 'i = i + k' with constant k
+std::optional<long long> getStep(const Expr* inc, const VarDecl* index, const ASTContext& Context) {
+	if (inc == nullptr) {
+		return std::nullopt;
+	}
+	inc = inc->IgnoreParenImpCasts();
+
+	if (const auto* unary = dyn_cast<UnaryOperator>(inc)) {
+		if (!unary->isIncrementDecrementOp() || !isReferenceTo(unary->getSubExpr(), index)) return std::nullopt;
+		return unary->isIncrementOp() ? 1 : -1;
+	}
+
+	const auto* binary = dyn_cast<BinaryOperator>(inc);
+	if (binary == nullptr || !isReferenceTo(binary->getLHS(), index)) {
+		return std::nullopt;
+	}
+	if (binary->getOpcode() == BO_AddAssign || binary->getOpcode() == BO_SubAssign) {
+		auto k = evaluateInt(binary->getRHS(), Context);
+		if (!k) return std::nullopt;
+		return binary->getOpcode() == BO_AddAssign ? *k : -*k;
+	}
+	if (binary->getOpcode() == BO_Assign) {
+		// i = i + k, i = i - k
+		const auto* rhs = dyn_cast<BinaryOperator>(binary->getRHS()->IgnoreParenImpCasts());
+		if (rhs == nullptr || !isReferenceTo(rhs->getLHS(), index)) return std::nullopt;
+		auto k = evaluateInt(rhs->getRHS(), Context);
+		if (!k) return std::nullopt;
+		if (rhs->getOpcode() == BO_Add) return *k;
+		if (rhs->getOpcode() == BO_Sub) return -*k;
+	}
+	return std::nullopt;
+}
+
+// index of loop and its start value from 'int i = a' or 'i = a'
+std::pair<const VarDecl*, const Expr*> getIndexInit(const Stmt* init, const Expr* cond) {
+	if (const auto* decl = dyn_cast_or_null<DeclStmt>(init)) {
+		// other variables may be declared together with index, index is the one compared in condition
+		for (const auto* d : decl->decls()) {
+			const auto* vd = dyn_cast<VarDecl>(d);
+			if (vd != nullptr && vd->getInit() != nullptr && vd->getType()->isIntegerType()) {
+				const auto* c = dyn_cast_or_null<BinaryOperator>(cond != nullptr ? cond->IgnoreParenImpCasts() : nullptr);
+				if (c != nullptr && (isReferenceTo(c->getLHS(), vd) || isReferenceTo(c->getRHS(), vd))) {
+					return { vd, vd->getInit() };
+				}
+			}
+		}
+		return { nullptr, nullptr };
+	}
+
+	const auto* initExpr = dyn_cast_or_null<Expr>(init);
+	const auto* assign = initExpr != nullptr ? dyn_cast<BinaryOperator>(initExpr->IgnoreParenImpCasts()) : nullptr;
+	if (assign == nullptr || assign->getOpcode() != BO_Assign) {
+		return { nullptr, nullptr };
+	}
+	const auto* ref = dyn_cast<DeclRefExpr>(assign->getLHS()->IgnoreParenImpCasts());
+	const auto* vd = ref != nullptr ? dyn_cast<VarDecl>(ref->getDecl()) : nullptr;
+	if (vd == nullptr || !vd->getType()->isIntegerType()) {
+		return { nullptr, nullptr };
+	}
+	return { vd, assign->getRHS() };
+}
+
+// existing variable keeps value of C++ loop after it ends, python one stops one step earlier.
+// Such index is accepted only if it is not read outside of loop
+bool isReadOutside(const Stmt* S, const ForStmt* Loop, const VarDecl* index) {
+	if (S == nullptr || S == Loop) {
+		return false;
+	}
+	if (const auto* binary = dyn_cast<BinaryOperator>(S)) {
+		// plain assignment to index is not a read
+		if (binary->getOpcode() == BO_Assign && isReferenceTo(binary->getLHS(), index)) {
+			return isReadOutside(binary->getRHS(), Loop, index);
+		}
+	}
+	if (const auto* ref = dyn_cast<DeclRefExpr>(S)) {
+		return ref->getDecl() == index;
+	}
+	for (const auto* child : S->children()) {
+		if (isReadOutside(child, Loop, index)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+}
+
+std::string CountedLoop::getRange() const {
+	std::string range = "range(" + begin + ", " + end + (step != 1 ? ", " + std::to_string(step) : std::string()) + ")";
+	return isReversed ? "reversed(" + range + ")" : range;
+}
+
+std::string CountedLoop::getCount() const {
+	// loop with begin above end makes no iterations
+	long long first = 0;
+	long long last = 0;
+	if (!llvm::StringRef(begin).getAsInteger(10, first) && !llvm::StringRef(end).getAsInteger(10, last)) {
+		return std::to_string(std::max(0LL, last - first));
+	}
+	return begin == "0" ? "max(0, " + end + ")" : "max(0, (" + end + ") - (" + begin + "))";
+}
+
+std::optional<CountedLoop> analyzeCountedLoop(const ForStmt* Loop) {
+	auto [index, start] = getIndexInit(Loop->getInit(), Loop->getCond());
+	if (index == nullptr || start == nullptr || Loop->getCond() == nullptr) {
+		return std::nullopt;
+	}
+	const auto& Context = index->getASTContext();
+
+	if (!index->isLocalVarDecl() && !isa<ParmVarDecl>(index)) {
+		return std::nullopt;
+	}
+	if (!isa<DeclStmt>(Loop->getInit())) {
+		const auto* function = dyn_cast_or_null<FunctionDecl>(index->getParentFunctionOrMethod());
+		if (function == nullptr || isReadOutside(function->getBody(), Loop, index)) {
+			return std::nullopt;
+		}
+	}
+
+	auto step = getStep(Loop->getInc(), index, Context);
+	if (!step || *step == 0) {
+		return std::nullopt;
+	}
+
+	// condition 'index op bound', 'bound op index' is mirrored
+	const auto* cond = dyn_cast<BinaryOperator>(Loop->getCond()->IgnoreParenImpCasts());
+	if (cond == nullptr) {
+		return std::nullopt;
+	}
+	auto op = cond->getOpcode();
+	const Expr* bound = nullptr;
+	if (isReferenceTo(cond->getLHS(), index)) {
+		bound = cond->getRHS();
+	}
+	else if (isReferenceTo(cond->getRHS(), index)) {
+		bound = cond->getLHS();
+		switch (op) {
+		case BO_LT: op = BO_GT; break;
+		case BO_LE: op = BO_GE; break;
+		case BO_GT: op = BO_LT; break;
+		case BO_GE: op = BO_LE; break;
+		default: break;
+		}
+	}
+	if (bound == nullptr) {
+		return std::nullopt;
+	}
+
+	// index is changed only by increment, bound does not change at all
+	Writes writes;
+	collectWrites(Loop->getBody(), writes);
+	bool isIndexWritten = writes.decls.count(index) != 0;
+	collectWrites(Loop->getInc(), writes);
+	if (isIndexWritten || !isInvariant(bound, writes)) {
+		return std::nullopt;
+	}
+	// '!=' reaches bound only by unit step
+	if (op == BO_NE && *step != 1 && *step != -1) {
+		return std::nullopt;
+	}
+	// unsigned 'i >= 0' never ends
+	if (op == BO_GE && index->getType()->isUnsignedIntegerType() && evaluateInt(bound, Context) == 0) {
+		return std::nullopt;
+	}
+
+	CountedLoop loop;
+	loop.index = index;
+	bool isAscending = *step > 0;
+	if (isAscending && (op == BO_LT || op == BO_NE)) {
+		loop.begin = addOffset(start, 0, Context);
+		loop.end = addOffset(bound, 0, Context);
+		loop.step = *step;
+	}
+	else if (isAscending && op == BO_LE) {
+		loop.begin = addOffset(start, 0, Context);
+		loop.end = addOffset(bound, 1, Context);
+		loop.step = *step;
+	}
+	else if (!isAscending && (op == BO_GT || op == BO_GE || op == BO_NE)) {
+		long long last = op == BO_GE ? 0 : 1;
+		if (*step == -1) {
+			// from start down to bound: reversed(range(bound + 1, start + 1))
+			loop.begin = addOffset(bound, last, Context);
+			loop.end = addOffset(start, 1, Context);
+			loop.isReversed = true;
+		}
+		else {
+			loop.begin = addOffset(start, 0, Context);
+			loop.end = addOffset(bound, last - 1, Context);
+			loop.step = *step;
+		}
+	}
+	else {
+		// index moves away from bound
+		return std::nullopt;
+	}
+	return loop;
+}
+
+namespace {
+
+// 'self.a.b' or 'v.a': root variable (null for this) and fields accessed from it
+struct AccessChain {
+	const ValueDecl* root = nullptr;
+	llvm::SmallVector<const ValueDecl*, 4> fields;
+	// some field is read through pointer other than 'this', python gets None there for null
+	bool isThroughPointer = false;
+};
+
+std::optional<AccessChain> getAccessChain(const Expr* E) {
+	E = E->IgnoreParenImpCasts();
+	if (isa<CXXThisExpr>(E)) {
+		return AccessChain{};
+	}
+	if (const auto* ref = dyn_cast<DeclRefExpr>(E)) {
+		const auto* var = dyn_cast<VarDecl>(ref->getDecl());
+		if (var == nullptr || !(var->isLocalVarDecl() || isa<ParmVarDecl>(var))) return std::nullopt;
+		AccessChain chain;
+		chain.root = var;
+		return chain;
+	}
+	if (const auto* member = dyn_cast<MemberExpr>(E)) {
+		if (!isa<FieldDecl>(member->getMemberDecl())) return std::nullopt;
+		auto chain = getAccessChain(member->getBase());
+		if (chain) {
+			chain->fields.push_back(member->getMemberDecl());
+			chain->isThroughPointer |= member->isArrow() && !isa<CXXThisExpr>(member->getBase()->IgnoreParenImpCasts());
+		}
+		return chain;
+	}
+	return std::nullopt;
+}
+
+bool isPrefix(const AccessChain& prefix, const AccessChain& chain) {
+	return prefix.root == chain.root && prefix.fields.size() <= chain.fields.size()
+		&& std::equal(prefix.fields.begin(), prefix.fields.end(), chain.fields.begin());
+}
+
+// element access of std sequence does not change its length
+bool isElementAccess(const CXXMethodDecl* method) {
+	const auto* record = method->getParent();
+	auto recordName = record->getName();
+	if (!record->isInStdNamespace()
+		|| (recordName != "vector" && recordName != "array" && recordName != "deque" && recordName != "basic_string")) {
+		return false;
+	}
+	auto name = method->getNameAsString();
+	return name == "operator[]" || name == "at" || name == "front" || name == "back" || name == "data"
+		|| name == "begin" || name == "end";
+}
+
+// object type compared with types of objects written through pointers and references
+const Type* getObjectType(QualType type) {
+	return type.isNull() ? nullptr : type.getNonReferenceType()->getCanonicalTypeUnqualified().getTypePtr();
+}
+
+// what one iteration of loop does to objects reachable from outside of it
+class LoopEffects {
+public:
+	void collect(const Stmt* S);
+
+	bool isRebound(const AccessChain& chain) const;
+	bool isResized(const AccessChain& chain) const;
+	bool isDeclared(const AccessChain& chain) const { return chain.root != nullptr && declared.count(chain.root); }
+	// object of chain has type written through pointer or reference, which may be bound to it
+	// before loop ('Foo* p = this;' and 'p->a = x' in loop)
+	bool isAliased(const AccessChain& chain) const;
+private:
+	void rebind(const Expr* E) {
+		if (auto chain = getAccessChain(E)) rebound.push_back(std::move(*chain));
+		addAliasedWrite(E);
+	}
+	void mutate(const Expr* E) {
+		if (auto chain = getAccessChain(E)) mutated.push_back(std::move(*chain));
+		addAliasedWrite(E);
+	}
+	void addAliased(QualType type) {
+		if (const auto* T = getObjectType(type)) aliased.insert(T);
+	}
+	void addAliasedWrite(const Expr* E);
+
+	// python name is bound to another object: chain and all chains through it are stale
+	std::vector<AccessChain> rebound;
+	// object is changed in place: its length and fields are stale, the object itself is not
+	std::vector<AccessChain> mutated;
+	llvm::DenseSet<const ValueDecl*> declared;
+	// types of objects written through pointers (other than this) and references
+	llvm::DenseSet<const Type*> aliased;
+};
+
+void LoopEffects::addAliasedWrite(const Expr* E) {
+	E = E->IgnoreParenImpCasts();
+	if (const auto* member = dyn_cast<MemberExpr>(E)) {
+		const auto* base = member->getBase()->IgnoreParenImpCasts();
+		if (member->isArrow() && !isa<CXXThisExpr>(base)) addAliased(base->getType()->getPointeeType());
+		addAliasedWrite(base);
+	}
+	else if (const auto* subscript = dyn_cast<ArraySubscriptExpr>(E)) {
+		if (subscript->getBase()->getType()->isPointerType()) addAliased(E->getType());
+		addAliasedWrite(subscript->getBase());
+	}
+	else if (const auto* unary = dyn_cast<UnaryOperator>(E)) {
+		if (unary->getOpcode() == UO_Deref) addAliased(E->getType());
+	}
+	else if (const auto* op = dyn_cast<CXXOperatorCallExpr>(E)) {
+		// '*it' or '*ptr' of smart pointer
+		if (op->getOperator() == OO_Star) addAliased(E->getType());
+		else if (op->getOperator() == OO_Subscript) addAliasedWrite(op->getArg(0));
+	}
+	else if (const auto* ref = dyn_cast<DeclRefExpr>(E)) {
+		const auto* var = dyn_cast<VarDecl>(ref->getDecl());
+		// reference declared in loop is bound to chain, which is mutated by its declaration
+		if (var != nullptr && var->getType()->isReferenceType() && declared.count(var) == 0) addAliased(var->getType());
+	}
+}
+
+bool LoopEffects::isAliased(const AccessChain& chain) const {
+	auto isWritten = [this](QualType type) {
+		const auto* T = getObjectType(type);
+		if (T == nullptr) {
+			return false;
+		}
+		if (aliased.count(T) != 0) {
+			return true;
+		}
+		// pointer to derived class writes fields of its bases, pointer to base fields of derived object
+		const auto* record = T->getAsCXXRecordDecl();
+		return record != nullptr && record->hasDefinition() && llvm::any_of(aliased, [record](const Type* A) {
+			const auto* other = A->getAsCXXRecordDecl();
+			return other != nullptr && other->hasDefinition() && (record->isDerivedFrom(other) || other->isDerivedFrom(record));
+		});
+	};
+	if (chain.root != nullptr && isWritten(chain.root->getType())) {
+		return true;
+	}
+	for (const auto* f : chain.fields) {
+		const auto* field = cast<FieldDecl>(f);
+		const auto* parent = field->getParent()->getTypeForDecl();
+		if (isWritten(field->getType()) || (parent != nullptr && isWritten(QualType(parent, 0)))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void LoopEffects::collect(const Stmt* S) {
+	if (S == nullptr) {
+		return;
+	}
+
+	if (const auto* binary = dyn_cast<BinaryOperator>(S)) {
+		if (binary->isAssignmentOp()) rebind(binary->getLHS());
+	}
+	else if (const auto* unary = dyn_cast<UnaryOperator>(S)) {
+		if (unary->isIncrementDecrementOp()) rebind(unary->getSubExpr());
+		else if (unary->getOpcode() == UO_AddrOf) mutate(unary->getSubExpr());
+	}
+	else if (const auto* op = dyn_cast<CXXOperatorCallExpr>(S)) {
+		const auto* method = dyn_cast_or_null<CXXMethodDecl>(op->getDirectCallee());
+		if (op->isAssignmentOp() || op->getOperator() == OO_PlusPlus || op->getOperator() == OO_MinusMinus) {
+			rebind(op->getArg(0));
+		}
+		else if (method != nullptr && !method->isConst() && !isElementAccess(method)) {
+			mutate(op->getArg(0));
+		}
+	}
+	else if (const auto* member = dyn_cast<CXXMemberCallExpr>(S)) {
+		const auto* method = member->getMethodDecl();
+		const auto* object = member->getImplicitObjectArgument();
+		if (getNumpyContainer(object) != nullptr) {
+			// np.append gives new array
+			if (method == nullptr || !method->isConst()) rebind(object);
+		}
+		else if (method == nullptr || (!method->isConst() && !isElementAccess(method))) {
+			mutate(object);
+		}
+	}
+	else if (const auto* call = dyn_cast<CallExpr>(S)) {
+		const auto* f = call->getDirectCallee();
+		for (unsigned i = 0; i < call->getNumArgs(); i++) {
+			QualType type = f != nullptr && i < f->getNumParams() ? f->getParamDecl(i)->getType() : QualType();
+			if (type.isNull() || ((type->isReferenceType() || type->isPointerType()) && !type->getPointeeType().isConstQualified())) {
+				mutate(call->getArg(i));
+			}
+			// pointed objects may be written, e.g. by std::fill
+			auto argType = call->getArg(i)->getType();
+			if (argType->isPointerType() && !argType->getPointeeType().isConstQualified()) {
+				addAliased(argType->getPointeeType());
+			}
+		}
+	}
+	else if (const auto* decl = dyn_cast<DeclStmt>(S)) {
+		for (const auto* d : decl->decls()) {
+			const auto* vd = dyn_cast<VarDecl>(d);
+			if (vd == nullptr) continue;
+			declared.insert(vd);
+			// changes through non-const reference are changes of referenced object
+			if (vd->getType()->isReferenceType() && !vd->getType().getNonReferenceType().isConstQualified() && vd->getInit() != nullptr) {
+				mutate(vd->getInit());
+			}
+		}
+	}
+
+	for (const auto* child : S->children()) {
+		collect(child);
+	}
+}
+
+bool LoopEffects::isRebound(const AccessChain& chain) const {
+	for (const auto& r : rebound) {
+		if (isPrefix(r, chain)) return true;
+	}
+	// fields of changed object may be assigned
+	for (const auto& m : mutated) {
+		if (m.fields.size() < chain.fields.size() && isPrefix(m, chain)) return true;
+	}
+	return false;
+}
+
+bool LoopEffects::isResized(const AccessChain& chain) const {
+	for (const auto& m : mutated) {
+		if (isPrefix(m, chain)) return true;
+	}
+	return isRebound(chain);
+}
+
+struct Candidate {
+	const Expr* E;
+	// evaluated by loop before its first iteration, so hoisted value is computed even by C++ code
+	bool isEvaluatedFirst;
+};
+
+// expressions which may be invariant, field chains are taken whole.
+// Operands which are evaluated only sometimes (branches, right side of 'and') are not evaluated first
+void collectCandidates(const Stmt* S, std::vector<Candidate>& candidates, bool isEvaluatedFirst) {
+	if (S == nullptr) {
+		return;
+	}
+
+	if (const auto* member = dyn_cast<MemberExpr>(S)) {
+		if (isa<FieldDecl>(member->getMemberDecl()) && getAccessChain(member)) {
+			candidates.push_back({ member, isEvaluatedFirst });
+			return;
+		}
+	}
+	else if (const auto* binary = dyn_cast<BinaryOperator>(S); binary != nullptr && binary->isLogicalOp()) {
+		collectCandidates(binary->getLHS(), candidates, isEvaluatedFirst);
+		collectCandidates(binary->getRHS(), candidates, false);
+		return;
+	}
+	else if (const auto* conditional = dyn_cast<AbstractConditionalOperator>(S)) {
+		collectCandidates(conditional->getCond(), candidates, isEvaluatedFirst);
+		collectCandidates(conditional->getTrueExpr(), candidates, false);
+		collectCandidates(conditional->getFalseExpr(), candidates, false);
+		return;
+	}
+	else if (isa<CXXMemberCallExpr>(S)) {
+		candidates.push_back({ cast<CXXMemberCallExpr>(S), isEvaluatedFirst });
+	}
+	else if (const auto* call = dyn_cast<CallExpr>(S); call != nullptr && !isa<CXXOperatorCallExpr>(S)) {
+		const auto* f = call->getDirectCallee();
+		// names of library functions exist in python only if there is rule for them
+		bool isModuleFunction = f != nullptr && !f->isInStdNamespace() && f->isDefined();
+		if (f != nullptr && !isa<CXXMethodDecl>(f) && (isModuleFunction || findCallRule(f, call->getNumArgs()) != nullptr)) {
+			candidates.push_back({ call, isEvaluatedFirst });
+		}
+	}
+
+	for (const auto* child : S->children()) {
+		collectCandidates(child, candidates, isEvaluatedFirst);
+	}
+}
+
+}
+
+std::vector<const Expr*> findLoopInvariants(const Stmt* Loop) {
+	// parts of loop executed on every iteration. Only condition is executed before the first one,
+	// loop with zero iterations does not evaluate others
+	std::vector<std::pair<const Stmt*, bool>> parts;
+	if (const auto* loop = dyn_cast<ForStmt>(Loop)) {
+		parts = { { loop->getCond(), true }, { loop->getInc(), false }, { loop->getBody(), false } };
+	}
+	else if (const auto* loop = dyn_cast<WhileStmt>(Loop)) {
+		parts = { { loop->getCond(), true }, { loop->getBody(), false } };
+	}
+	else if (const auto* loop = dyn_cast<CXXForRangeStmt>(Loop)) {
+		parts = { { loop->getLoopVarStmt(), false }, { loop->getBody(), false } };
+	}
+
+	LoopEffects effects;
+	Writes writes;
+	std::vector<Candidate> candidates;
+	for (const auto& [part, isCondition] : parts) {
+		effects.collect(part);
+		collectWrites(part, writes);
+		collectCandidates(part, candidates, isCondition);
+	}
+
+	// hoisted expression is computed before loop even if C++ code never evaluates it. Fields of
+	// objects and their lengths exist always, but read through null pointer or call may raise
+	std::vector<const Expr*> invariants;
+	for (const auto& [E, isEvaluatedFirst] : candidates) {
+		std::optional<AccessChain> chain;
+		bool isLength = false;
+		if (const auto* call = dyn_cast<CXXMemberCallExpr>(E)) {
+			const auto* object = call->getImplicitObjectArgument();
+			chain = getAccessChain(object);
+			isLength = call->getMethodDecl() != nullptr && call->getMethodDecl()->getName() == "size" && call->getNumArgs() == 0;
+			if (chain && object->getType()->isPointerType() && !isa<CXXThisExpr>(object->IgnoreParenImpCasts())) {
+				chain->isThroughPointer = true;
+			}
+		}
+		else if (isa<MemberExpr>(E)) {
+			chain = getAccessChain(E);
+		}
+		else {
+			// module level name
+			if (isEvaluatedFirst) invariants.push_back(E);
+			continue;
+		}
+
+		if (!chain || effects.isDeclared(*chain) || effects.isRebound(*chain) || (isLength && effects.isResized(*chain))) {
+			continue;
+		}
+		// user function may change any object, pointer or reference any object of its type
+		if (writes.hasOpaqueCall || effects.isAliased(*chain)) {
+			continue;
+		}
+		bool isSafe = !chain->isThroughPointer && (isLength || isa<MemberExpr>(E));
+		if (isSafe || isEvaluatedFirst) {
+			invariants.push_back(E);
+		}
+	}
+	return invariants;
+}
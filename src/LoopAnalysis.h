@@ -0,0 +1,38 @@
+#pragma once
+#include "clang/AST/Decl.h"
+#include "clang/AST/Stmt.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+// for loop which runs index over arithmetic progression, emitted as python range().
+// begin/end/step are arguments of range(), for reversed loops of ascending range under reversed()
+struct CountedLoop {
+	const VarDecl* index = nullptr;
+	std::string begin;
+	std::string end;
+	long long step = 1;
+	bool isReversed = false;
+
+	// 'range(b, e)', 'range(b, e, k)' or 'reversed(range(b, e))'
+	std::string getRange() const;
+	// every index from begin to end is visited once in increasing order
+	bool isAscendingByOne() const { return step == 1 && !isReversed; }
+	// number of iterations of ascending loop, 'max(0, (e) - (b))' unless bounds are integer literals
+	std::string getCount() const;
+};
+
+// recognises 'for (i = a; i < n; ++i)' and its variants: declared or existing index,
+// ++/--/+=/-= by constant step, conditions <, <=, >, >=, != (with either operand order).
+// Index must not be changed in body and bound must not depend on anything changed by the loop
+std::optional<CountedLoop> analyzeCountedLoop(const ForStmt* Loop);
+
+// expressions of loop (for, while or range-for) which give the same python object on every iteration
+// and may be evaluated once before it: field chains 'self.a.b' (MemberExpr), bound methods 'v.f' and
+// 'len(v)' of unchanged v (CXXMemberCallExpr), module level functions (CallExpr).
+// Roots of chains are 'this', parameters and locals declared outside of loop. Chains are not hoisted
+// from loops with calls of user functions or with writes through pointer or reference to their objects
+std::vector<const Expr*> findLoopInvariants(const Stmt* Loop);
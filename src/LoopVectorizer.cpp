@@ -0,0 +1,264 @@
+#include "LoopVectorizer.h"
+#include "CallRules.h"
+#include "ContainerLowering.h"
+#include "ExpressionProcessor.h"
+
+#include "clang/AST/ExprCXX.h"
+
+#include <vector>
+
+namespace {
+
+enum VectorPrecedence {
+	VPREC_ADDITIVE,
+	VPREC_MULTIPLICATIVE,
+	VPREC_UNARY,
+	VPREC_ATOM
+};
+
+struct VectorExpr {
+	std::string text;
+	VectorPrecedence precedence;
+	// expression is an array slice, not a scalar
+	bool isArray;
+};
+
+// containers which are python lists or numpy arrays after translation
+bool isArrayType(QualType type) {
+	if (type->isConstantArrayType()) {
+		return true;
+	}
+	const auto* record = type->getAsCXXRecordDecl();
+	if (record == nullptr || !record->isInStdNamespace()) {
+		return false;
+	}
+	auto name = record->getName();
+	return name == "vector" || name == "array" || name == "valarray";
+}
+
+// array variable or field without side effects
+bool isSimpleBase(const Expr* E) {
+	E = E->IgnoreParenImpCasts();
+	if (const auto* member = dyn_cast<MemberExpr>(E)) {
+		const auto* base = member->getBase()->IgnoreParenImpCasts();
+		return isa<CXXThisExpr>(base) || isSimpleBase(base);
+	}
+	return isa<DeclRefExpr>(E);
+}
+
+class SliceBuilder {
+public:
+	explicit SliceBuilder(const CountedLoop& loop)
+		: loop(loop) {
+		slice = (loop.begin == "0" ? std::string() : loop.begin) + ":" + loop.end;
+	}
+
+	std::optional<LineBuffer> build(const Stmt* Body) {
+		std::vector<const Stmt*> statements;
+		if (const auto* compound = dyn_cast<CompoundStmt>(Body)) {
+			statements.assign(compound->body_begin(), compound->body_end());
+		}
+		else {
+			statements.push_back(Body);
+		}
+		if (statements.empty()) {
+			return std::nullopt;
+		}
+
+		LineBuffer lines;
+		for (const auto* s : statements) {
+			auto line = assignment(s);
+			if (!line) {
+				return std::nullopt;
+			}
+			lines.push_back(*line);
+		}
+		return lines;
+	}
+private:
+	const CountedLoop& loop;
+	std::string slice;
+
+	bool isIndex(const Expr* E) const {
+		const auto* ref = dyn_cast<DeclRefExpr>(E->IgnoreParenImpCasts());
+		return ref != nullptr && ref->getDecl() == loop.index;
+	}
+
+	// base of 'a[index]' if expression is such subscript
+	const Expr* getSubscriptBase(const Expr* E) const {
+		E = E->IgnoreParenImpCasts();
+		const Expr* base = nullptr;
+		const Expr* index = nullptr;
+		if (const auto* subscript = dyn_cast<ArraySubscriptExpr>(E)) {
+			base = subscript->getBase();
+			index = subscript->getIdx();
+		}
+		else if (const auto* call = dyn_cast<CXXOperatorCallExpr>(E)) {
+			if (call->getOperator() != OO_Subscript || call->getNumArgs() != 2) return nullptr;
+			base = call->getArg(0);
+			index = call->getArg(1);
+		}
+		if (base == nullptr || !isIndex(index) || !isSimpleBase(base) || !E->getType()->isArithmeticType()) {
+			return nullptr;
+		}
+		// pointers may alias with offset, only whole containers are safe
+		if (!isArrayType(base->IgnoreParenImpCasts()->getType().getNonReferenceType())) {
+			return nullptr;
+		}
+		return base;
+	}
+
+	std::string sliceOf(const Expr* base) const {
+		return processExpr(base->IgnoreParenImpCasts()) + "[" + slice + "]";
+	}
+
+	std::string operand(const VectorExpr& e, VectorPrecedence minPrecedence) const {
+		return e.precedence < minPrecedence ? "(" + e.text + ")" : e.text;
+	}
+
+	std::optional<std::string> assignment(const Stmt* S) const {
+		const auto* B = dyn_cast<BinaryOperator>(S);
+		if (const auto* E = dyn_cast<Expr>(S)) {
+			B = dyn_cast<BinaryOperator>(E->IgnoreImplicit());
+		}
+		if (B == nullptr || !B->isAssignmentOp()) {
+			return std::nullopt;
+		}
+
+		const auto* target = getSubscriptBase(B->getLHS());
+		auto value = expression(B->getRHS());
+		if (target == nullptr || !value) {
+			return std::nullopt;
+		}
+
+		auto lhs = sliceOf(target);
+		// 'a += x' is written as 'a = a + x', '+=' on python list would extend it
+		if (B->isCompoundAssignmentOp()) {
+			const char* op = nullptr;
+			VectorPrecedence precedence;
+			switch (B->getOpcode()) {
+			case BO_AddAssign: op = " + "; precedence = VPREC_ADDITIVE; break;
+			case BO_SubAssign: op = " - "; precedence = VPREC_ADDITIVE; break;
+			case BO_MulAssign: op = " * "; precedence = VPREC_MULTIPLICATIVE; break;
+			case BO_DivAssign: op = " / "; precedence = VPREC_MULTIPLICATIVE; break;
+			default: return std::nullopt;
+			}
+			if (B->getOpcode() == BO_DivAssign && B->getType()->isIntegerType()) {
+				return std::nullopt;
+			}
+			auto rhsPrecedence = static_cast<VectorPrecedence>(precedence + 1);
+			value = VectorExpr{ "np.asarray(" + lhs + ")" + op + operand(*value, rhsPrecedence), precedence, true };
+		}
+
+		if (!value->isArray) {
+			// numpy broadcasts scalar to slice, python list needs sequence of slice length
+			if (getNumpyContainer(target) != nullptr) {
+				return lhs + " = " + value->text;
+			}
+			return lhs + " = [" + value->text + "] * " + loop.getCount();
+		}
+		return lhs + " = " + value->text;
+	}
+
+	std::optional<VectorExpr> expression(const Expr* E) const {
+		E = E->IgnoreImplicit();
+
+		if (const auto* base = getSubscriptBase(E)) {
+			return VectorExpr{ "np.asarray(" + sliceOf(base) + ")", VPREC_ATOM, true };
+		}
+		if (const auto* paren = dyn_cast<ParenExpr>(E)) {
+			return expression(paren->getSubExpr());
+		}
+		if (const auto* cast = dyn_cast<ImplicitCastExpr>(E)) {
+			return expression(cast->getSubExpr());
+		}
+		if (isa<IntegerLiteral>(E) || isa<FloatingLiteral>(E)) {
+			return VectorExpr{ processExpr(E), VPREC_ATOM, false };
+		}
+		if (const auto* ref = dyn_cast<DeclRefExpr>(E)) {
+			// scalars are never written by accepted bodies, so they are loop invariant
+			if (ref->getDecl() == loop.index || !ref->getType()->isArithmeticType()) {
+				return std::nullopt;
+			}
+			return VectorExpr{ processExpr(E), VPREC_ATOM, false };
+		}
+		if (isa<MemberExpr>(E) && isSimpleBase(E) && E->getType()->isArithmeticType()) {
+			return VectorExpr{ processExpr(E), VPREC_ATOM, false };
+		}
+		if (const auto* unary = dyn_cast<UnaryOperator>(E)) {
+			auto sub = expression(unary->getSubExpr());
+			if (!sub) return std::nullopt;
+			switch (unary->getOpcode()) {
+			case UO_Minus: return VectorExpr{ "-" + operand(*sub, VPREC_UNARY), VPREC_UNARY, sub->isArray };
+			case UO_Plus: return sub;
+			default: return std::nullopt;
+			}
+		}
+		if (const auto* binary = dyn_cast<BinaryOperator>(E)) {
+			return binaryExpression(binary);
+		}
+		if (const auto* call = dyn_cast<CallExpr>(E)) {
+			return mathCall(call);
+		}
+		return std::nullopt;
+	}
+
+	std::optional<VectorExpr> binaryExpression(const BinaryOperator* B) const {
+		const char* op = nullptr;
+		VectorPrecedence precedence;
+		switch (B->getOpcode()) {
+		case BO_Add: op = " + "; precedence = VPREC_ADDITIVE; break;
+		case BO_Sub: op = " - "; precedence = VPREC_ADDITIVE; break;
+		case BO_Mul: op = " * "; precedence = VPREC_MULTIPLICATIVE; break;
+		case BO_Div: op = " / "; precedence = VPREC_MULTIPLICATIVE; break;
+		default: return std::nullopt;
+		}
+		// c++ integer division truncates, numpy one does not
+		if (B->getOpcode() == BO_Div && B->getType()->isIntegerType()) {
+			return std::nullopt;
+		}
+
+		auto lhs = expression(B->getLHS());
+		auto rhs = expression(B->getRHS());
+		if (!lhs || !rhs) {
+			return std::nullopt;
+		}
+		// right operand of '-' and '/' needs parentheses on equal precedence
+		auto rhsPrecedence = static_cast<VectorPrecedence>(precedence + 1);
+		return VectorExpr{ operand(*lhs, precedence) + op + operand(*rhs, rhsPrecedence), precedence, lhs->isArray || rhs->isArray };
+	}
+
+	// element-wise function by numpy form of call rule ('np.sqrt({0})')
+	std::optional<VectorExpr> mathCall(const CallExpr* C) const {
+		if (isa<CXXMemberCallExpr>(C) || isa<CXXOperatorCallExpr>(C)) {
+			return std::nullopt;
+		}
+		const auto* rule = findCallRule(C->getDirectCallee(), C->getNumArgs());
+		if (rule == nullptr || rule->numpy.empty()) {
+			return std::nullopt;
+		}
+
+		bool isArray = false;
+		auto text = expandRuleForm(rule->numpy, [&](const RulePlaceholder& p) -> std::optional<std::string> {
+			// only arguments passed directly to function are element-wise
+			if (p.kind != RulePlaceholder::Argument || !p.isDelimited || p.first >= C->getNumArgs()) return std::nullopt;
+			auto arg = expression(C->getArg(p.first));
+			if (!arg) return std::nullopt;
+			isArray |= arg->isArray;
+			return arg->text;
+		});
+		if (!text) {
+			return std::nullopt;
+		}
+		return VectorExpr{ *text, VPREC_ATOM, isArray };
+	}
+};
+
+}
+
+std::optional<LineBuffer> vectorizeLoop(const Stmt* Body, const CountedLoop& loop) {
+	if (Body == nullptr || loop.index == nullptr) {
+		return std::nullopt;
+	}
+	return SliceBuilder(loop).build(Body);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "clang/AST/Stmt.h"
+#include "clang/AST/Decl.h"
+#include "Lines.h"
+#include "LoopAnalysis.h"
+
+#include <optional>
+#include <string>
+
+using namespace clang;
+
+// translate body of counted loop to numpy slice assignments (c[a:n] = x[a:n] * y[a:n] + k).
+// Only bodies of independent element-wise assignments on arrays indexed by loop variable are
+// accepted, for everything else nullopt is returned and loop keeps its scalar form
+std::optional<LineBuffer> vectorizeLoop(const Stmt* Body, const CountedLoop& loop);
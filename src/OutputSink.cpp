@@ -0,0 +1,25 @@
+#include "OutputSink.h"
+#include "llvm/Support/FileSystem.h"
+
+// lines are emitted per declaration, so buffer should hold many declarations before write() syscall
+static const size_t fileSinkBufferSize = 256 * 1024;
+
+std::unique_ptr<llvm::raw_fd_ostream> openFileSink(const std::string& path, std::error_code& ec) {
+	auto sink = std::make_unique<llvm::raw_fd_ostream>(path, ec, llvm::sys::fs::OF_None);
+	if (ec) {
+		return nullptr;
+	}
+	sink->SetBufferSize(fileSinkBufferSize);
+	return sink;
+}
+
+bool closeFileSink(llvm::raw_fd_ostream& sink, const std::string& path) {
+	sink.close();
+	if (!sink.has_error()) {
+		return true;
+	}
+	llvm::errs() << "cannot write " << path << ": " << sink.error().message() << "\n";
+	sink.clear_error();
+	llvm::sys::fs::remove(path);
+	return false;
+}
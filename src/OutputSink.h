@@ -0,0 +1,15 @@
+#pragma once
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+
+// destination of translated python code. Any llvm::raw_ostream works: raw_fd_ostream for files,
+// raw_string_ostream / raw_svector_ostream for in-memory translation
+typedef llvm::raw_ostream OutputSink;
+
+// file sink which writes by large chunks. Returns null and sets ec if file cannot be created
+std::unique_ptr<llvm::raw_fd_ostream> openFileSink(const std::string& path, std::error_code& ec);
+
+// flush and close file. On write error (full disk, ...) the error is reported and cleared, otherwise
+// destructor of stream aborts the process, and partial file is removed
+bool closeFileSink(llvm::raw_fd_ostream& sink, const std::string& path);
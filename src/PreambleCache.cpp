@@ -0,0 +1,105 @@
+#include "PreambleCache.h"
+#include "TranslationUnitAction.h"
+#include "TranslationStats.h"
+
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+
+namespace {
+
+// records headers parsed into preamble, they are dependencies of every file which uses it
+class PreambleHeadersCallbacks : public PreambleCallbacks {
+public:
+	explicit PreambleHeadersCallbacks(std::vector<std::string>& headers)
+		: headers(headers) {}
+
+	void BeforeExecute(CompilerInstance& CI) override {
+		SM = &CI.getSourceManager();
+	}
+
+	std::unique_ptr<PPCallbacks> createPPCallbacks() override {
+		if (SM == nullptr) return nullptr;
+		return createIncludeCollector(*SM, headers);
+	}
+private:
+	std::vector<std::string>& headers;
+	const SourceManager* SM = nullptr;
+};
+
+}
+
+std::shared_ptr<const PreambleEntry> PreambleCache::build(const CompilerInvocation& invocation, const llvm::MemoryBuffer& mainFile,
+	PreambleBounds bounds, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs, std::shared_ptr<PCHContainerOperations> pchOps) {
+	PhaseScope phase(Phase::Preamble);
+	// errors in headers are reported when the file itself is parsed
+	IgnoringDiagConsumer ignore;
+	auto diagnostics = CompilerInstance::createDiagnostics(&invocation.getDiagnosticOpts(), &ignore, false);
+
+	std::vector<std::string> headers;
+	PreambleHeadersCallbacks callbacks(headers);
+	auto preamble = PrecompiledPreamble::Build(invocation, &mainFile, bounds, *diagnostics, fs, pchOps,
+		/*StoreInMemory=*/false, callbacks);
+	if (!preamble) {
+		return nullptr;
+	}
+
+	built++;
+	return std::make_shared<PreambleEntry>(PreambleEntry{ std::move(*preamble), std::move(headers) });
+}
+
+std::shared_ptr<const PreambleEntry> PreambleCache::get(const std::string& key, const CompilerInvocation& invocation,
+	const llvm::MemoryBuffer& mainFile, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs,
+	std::shared_ptr<PCHContainerOperations> pchOps) {
+	auto bounds = ComputePreambleBounds(*invocation.getLangOpts(), mainFile.getMemBufferRef(), 0);
+	if (bounds.Size == 0) {
+		return nullptr;
+	}
+
+	std::string slotKey = key;
+	slotKey.push_back('\0');
+	slotKey.append(mainFile.getBufferStart(), bounds.Size);
+
+	std::promise<std::shared_ptr<const PreambleEntry>> promise;
+	std::shared_future<std::shared_ptr<const PreambleEntry>> entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& slot = slots[slotKey];
+		if (++slot.uses == 1) {
+			// first file with this prefix: it is cheaper to parse it as is
+			return nullptr;
+		}
+		entry = slot.entry;
+		if (!entry.valid()) {
+			slot.entry = promise.get_future().share();
+		}
+	}
+
+	if (!entry.valid()) {
+		// this worker builds, others with the same prefix wait for it
+		auto preamble = build(invocation, mainFile, bounds, fs, pchOps);
+		promise.set_value(preamble);
+		return preamble;
+	}
+
+	auto preamble = entry.get();
+	if (preamble == nullptr) {
+		return nullptr;
+	}
+	if (!preamble->preamble.CanReuse(invocation, mainFile.getMemBufferRef(), bounds, *fs)) {
+		// header of preamble was changed (resident server): next file with this prefix builds it again
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& slot = slots[slotKey];
+		if (slot.entry.valid() && slot.entry.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+			&& slot.entry.get() == preamble) {
+			slot.uses = 1;
+			slot.entry = {};
+		}
+		return nullptr;
+	}
+	reused++;
+	return preamble;
+}
+
+void PreambleCache::printStats(OutputSink& out) const {
+	out << "preambles: " << built << " built, " << reused << " reused\n";
+}
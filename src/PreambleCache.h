@@ -0,0 +1,45 @@
+#pragma once
+#include "OutputSink.h"
+#include "clang/Frontend/PrecompiledPreamble.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace clang;
+
+// precompiled preamble with user headers which were parsed into it
+struct PreambleEntry {
+	PrecompiledPreamble preamble;
+	std::vector<std::string> headers;
+};
+
+// precompiled preambles shared by all workers of a run. Files starting with the same block of
+// #include directives (same text, directory and flags) parse their headers once into a PCH.
+// Preamble is built when its prefix is seen the second time, unique prefixes are never precompiled
+class PreambleCache {
+public:
+	// preamble for main file of invocation or null if there is nothing to reuse (yet).
+	// key identifies flags and directory of main file
+	std::shared_ptr<const PreambleEntry> get(const std::string& key, const CompilerInvocation& invocation,
+		const llvm::MemoryBuffer& mainFile, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs,
+		std::shared_ptr<PCHContainerOperations> pchOps);
+
+	void printStats(OutputSink& out) const;
+private:
+	struct Slot {
+		size_t uses = 0;
+		std::shared_future<std::shared_ptr<const PreambleEntry>> entry;
+	};
+	std::mutex mutex;
+	std::unordered_map<std::string, Slot> slots;
+	std::atomic<size_t> built{ 0 };
+	std::atomic<size_t> reused{ 0 };
+
+	std::shared_ptr<const PreambleEntry> build(const CompilerInvocation& invocation, const llvm::MemoryBuffer& mainFile,
+		PreambleBounds bounds, llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs, std::shared_ptr<PCHContainerOperations> pchOps);
+};
@@ -0,0 +1,140 @@
+#include "Server.h"
+#include "TranslationCache.h"
+
+#include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static std::string getAbsolutePath(llvm::StringRef path) {
+	return fs::absolute(fs::path(path.str())).lexically_normal().string();
+}
+
+static void addUnsavedFile(llvm::vfs::InMemoryFileSystem& unsaved, const std::string& path, llvm::StringRef content) {
+	unsaved.addFile(path, 0, llvm::MemoryBuffer::getMemBufferCopy(content, path));
+}
+
+static bool translateRequest(const llvm::json::Object& request, TranslationSession& session, llvm::json::Object& response) {
+	auto file = request.getString("file");
+	if (!file) {
+		response["error"] = "request has no file";
+		return false;
+	}
+	auto input = getAbsolutePath(*file);
+
+	// buffers live only until the end of request
+	session.unsaved = nullptr;
+	auto content = request.getString("content");
+	auto others = request.getObject("unsaved");
+	if (content || others) {
+		session.unsaved = new llvm::vfs::InMemoryFileSystem();
+		if (content) {
+			addUnsavedFile(*session.unsaved, input, *content);
+		}
+		if (others) {
+			for (const auto& [path, text] : *others) {
+				if (auto value = text.getAsString()) {
+					addUnsavedFile(*session.unsaved, getAbsolutePath(path), *value);
+				}
+			}
+		}
+	}
+
+	bool isTranslated;
+	if (auto output = request.getString("output")) {
+		std::error_code ec;
+		auto path = getAbsolutePath(*output);
+		fs::create_directories(fs::path(path).parent_path(), ec);
+		auto out = openFileSink(path, ec);
+		if (!out) {
+			response["error"] = "cannot write " + path + ": " + ec.message();
+			session.unsaved = nullptr;
+			return false;
+		}
+		isTranslated = translateFile(input, *out, session);
+		if (!closeFileSink(*out, path)) {
+			response["error"] = "cannot write " + path;
+			session.unsaved = nullptr;
+			return false;
+		}
+	}
+	else {
+		std::string python;
+		llvm::raw_string_ostream str(python);
+		isTranslated = translateFile(input, str, session);
+		str.flush();
+		response["python"] = std::move(python);
+	}
+	session.unsaved = nullptr;
+
+	if (!isTranslated) {
+		// diagnostics of clang are printed to stderr
+		response["error"] = "cannot translate " + input;
+	}
+	return isTranslated;
+}
+
+int runServer(std::istream& in, OutputSink& out, TranslationSession& session) {
+	llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> physical(llvm::vfs::createPhysicalFileSystem().release());
+	// crash or fatal error of one request is reported to client, server keeps running
+	llvm::CrashRecoveryContext::Enable();
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (llvm::StringRef(line).trim().empty()) {
+			continue;
+		}
+		auto start = std::chrono::steady_clock::now();
+
+		llvm::json::Object response;
+		auto request = llvm::json::parse(line);
+		if (!request || request->getAsObject() == nullptr) {
+			response["ok"] = false;
+			response["error"] = request ? std::string("request is not an object") : llvm::toString(request.takeError());
+		}
+		else {
+			const auto& object = *request->getAsObject();
+			if (auto id = object.get("id")) {
+				response["id"] = *id;
+			}
+			if (object.getBoolean("shutdown").getValueOr(false)) {
+				response["ok"] = true;
+				out << llvm::json::Value(std::move(response)) << "\n";
+				out.flush();
+				break;
+			}
+
+			// files may be changed by editor or build between requests
+			session.files.refresh(*physical);
+			if (session.cache != nullptr) {
+				session.cache->resetFileHashes();
+			}
+			bool isTranslated = false;
+			llvm::CrashRecoveryContext recovery;
+			bool isFinished = recovery.RunSafely([&] {
+				try {
+					isTranslated = translateRequest(object, session, response);
+				}
+				catch (const std::exception& e) {
+					response["error"] = std::string("translation failed: ") + e.what();
+				}
+			});
+			if (!isFinished) {
+				response["error"] = "translation crashed";
+			}
+			session.unsaved = nullptr;
+			response["ok"] = isTranslated;
+		}
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		response["milliseconds"] = static_cast<int64_t>(elapsed.count());
+		out << llvm::json::Value(std::move(response)) << "\n";
+		out.flush();
+	}
+	return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "BatchTranslator.h"
+#include <istream>
+
+// resident translator for editors and build steps. Reads one JSON request per line:
+//   {"id": 1, "file": "a.cpp", "content": "...", "unsaved": {"a.h": "..."}, "output": "a.py"}
+// "content" and "unsaved" are editor buffers used instead of files on disk, translation is written
+// to "output" or returned in response. One JSON response is written per request:
+//   {"id": 1, "ok": true, "python": "...", "milliseconds": 12}
+// Compile commands, options, rules, file cache and preambles of session stay loaded between requests.
+// Requests with buffers are translated without preamble, translation cache and header modules.
+// Failed or crashed request gets error response, server keeps running.
+// Server stops at end of input or on {"shutdown": true}
+int runServer(std::istream& in, OutputSink& out, TranslationSession& session);
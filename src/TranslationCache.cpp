@@ -0,0 +1,166 @@
+#include "TranslationCache.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+
+#ifndef CPP2PYTHON_VERSION
+#define CPP2PYTHON_VERSION "dev"
+#endif
+
+static std::string toHash(llvm::SHA1& hasher) {
+	return llvm::toHex(hasher.final(), true);
+}
+
+TranslationCache::TranslationCache(std::string directory)
+	: directory(std::move(directory)) {
+	llvm::sys::fs::create_directories(this->directory);
+}
+
+std::optional<std::string> TranslationCache::getFileHash(const std::string& path) {
+	{
+		std::lock_guard<std::mutex> lock(hashesMutex);
+		auto it = fileHashes.find(path);
+		if (it != fileHashes.end()) {
+			return it->second;
+		}
+	}
+
+	std::optional<std::string> hash;
+	if (auto buffer = llvm::MemoryBuffer::getFile(path)) {
+		llvm::SHA1 hasher;
+		hasher.update((*buffer)->getBuffer());
+		hash = toHash(hasher);
+	}
+
+	std::lock_guard<std::mutex> lock(hashesMutex);
+	return fileHashes.try_emplace(path, hash).first->second;
+}
+
+std::optional<std::string> TranslationCache::getEntryKey(const std::string& input, const std::vector<std::string>& flags) {
+	auto content = getFileHash(input);
+	if (!content) {
+		return std::nullopt;
+	}
+
+	// path is a part of key: same content in other directory may include other headers
+	llvm::SHA1 hasher;
+	hasher.update(CPP2PYTHON_VERSION);
+	hasher.update(llvm::StringRef("\0", 1));
+	for (const auto& f : flags) {
+		hasher.update(f);
+		hasher.update(llvm::StringRef("\0", 1));
+	}
+	hasher.update(input);
+	hasher.update(llvm::StringRef("\0", 1));
+	hasher.update(*content);
+	return toHash(hasher);
+}
+
+std::string TranslationCache::getEntryPath(const std::string& key, const char* extension) const {
+	llvm::SmallString<256> path(directory);
+	// two-level layout keeps directories small
+	llvm::sys::path::append(path, key.substr(0, 2), key.substr(2) + extension);
+	return std::string(path.str());
+}
+
+bool TranslationCache::writeAtomically(const std::string& path, llvm::StringRef content) const {
+	llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path));
+
+	// concurrent runs may write same entry, readers must never see partial file
+	int fd = -1;
+	llvm::SmallString<256> tempPath;
+	if (llvm::sys::fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd, tempPath)) {
+		return false;
+	}
+	{
+		llvm::raw_fd_ostream out(fd, true);
+		out << content;
+		// buffered tail is written by close, its error is seen only after it
+		out.close();
+		if (out.has_error()) {
+			out.clear_error();
+			llvm::sys::fs::remove(tempPath);
+			return false;
+		}
+	}
+	if (llvm::sys::fs::rename(tempPath, path)) {
+		llvm::sys::fs::remove(tempPath);
+		return false;
+	}
+	return true;
+}
+
+std::optional<std::string> TranslationCache::lookup(const std::string& input, const std::vector<std::string>& flags) {
+	auto key = getEntryKey(input, flags);
+	auto manifest = key ? llvm::MemoryBuffer::getFile(getEntryPath(*key, ".manifest")) : nullptr;
+	if (!manifest) {
+		misses++;
+		return std::nullopt;
+	}
+
+	// manifest line: <hash> <header path>
+	llvm::SHA1 hasher;
+	hasher.update(*key);
+	llvm::SmallVector<llvm::StringRef, 64> lines;
+	(*manifest)->getBuffer().split(lines, '\n', -1, false);
+	for (auto line : lines) {
+		auto [hash, header] = line.split(' ');
+		auto actual = getFileHash(header.str());
+		if (!actual || *actual != hash) {
+			misses++;
+			return std::nullopt;
+		}
+		hasher.update(hash);
+	}
+
+	auto python = llvm::MemoryBuffer::getFile(getEntryPath(toHash(hasher), ".py"));
+	if (!python) {
+		misses++;
+		return std::nullopt;
+	}
+	hits++;
+	return (*python)->getBuffer().str();
+}
+
+void TranslationCache::store(const std::string& input, const std::vector<std::string>& flags,
+	const std::vector<std::string>& headers, const std::string& python) {
+	auto key = getEntryKey(input, flags);
+	if (!key) {
+		return;
+	}
+
+	std::string manifest;
+	llvm::SHA1 hasher;
+	hasher.update(*key);
+	for (const auto& header : headers) {
+		auto hash = getFileHash(header);
+		if (!hash) {
+			// header disappeared during run, entry would never be valid
+			return;
+		}
+		manifest += *hash + " " + header + "\n";
+		hasher.update(*hash);
+	}
+
+	// python first: manifest makes entry visible
+	if (writeAtomically(getEntryPath(toHash(hasher), ".py"), python)) {
+		writeAtomically(getEntryPath(*key, ".manifest"), manifest);
+	}
+}
+
+void TranslationCache::resetFileHashes() {
+	std::lock_guard<std::mutex> lock(hashesMutex);
+	fileHashes.clear();
+}
+
+void TranslationCache::printStats(OutputSink& out) const {
+	size_t total = hits + misses;
+	out << "translation cache: " << hits << " hits, " << misses << " misses";
+	if (total > 0) {
+		out << " (" << (100 * hits / total) << "% hit rate)";
+	}
+	out << "\n";
+}
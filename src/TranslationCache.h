@@ -0,0 +1,42 @@
+#pragma once
+#include "OutputSink.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// on-disk cache of translated files.
+// Entry is found by hash of translator version, compile flags, path and content of the main file.
+// Its manifest lists every non-system header of the TU with content hash: stored python is returned
+// only if all of them are unchanged, so hit does not need preprocessor or AST
+class TranslationCache {
+public:
+	explicit TranslationCache(std::string directory);
+
+	// stored translation of input or nullopt
+	std::optional<std::string> lookup(const std::string& input, const std::vector<std::string>& flags);
+	// remember translation and headers which were included by input
+	void store(const std::string& input, const std::vector<std::string>& flags,
+		const std::vector<std::string>& headers, const std::string& python);
+
+	// forget hashes of headers, resident server hashes them again for each request
+	void resetFileHashes();
+
+	void printStats(OutputSink& out) const;
+private:
+	std::string directory;
+	std::atomic<size_t> hits{ 0 };
+	std::atomic<size_t> misses{ 0 };
+
+	// headers are shared by many files, hash each of them once per run
+	std::mutex hashesMutex;
+	llvm::StringMap<std::optional<std::string>> fileHashes;
+
+	std::optional<std::string> getFileHash(const std::string& path);
+	std::optional<std::string> getEntryKey(const std::string& input, const std::vector<std::string>& flags);
+	std::string getEntryPath(const std::string& key, const char* extension) const;
+	bool writeAtomically(const std::string& path, llvm::StringRef content) const;
+};
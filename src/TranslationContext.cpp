@@ -0,0 +1,23 @@
+#include "TranslationContext.h"
+
+static thread_local ASTContext* currentContext = nullptr;
+static thread_local std::mutex* currentMutex = nullptr;
+
+ASTContextScope::ASTContextScope(ASTContext& Context, std::mutex* mutex)
+	: previous(currentContext), previousMutex(currentMutex) {
+	currentContext = &Context;
+	currentMutex = mutex;
+}
+
+ASTContextScope::~ASTContextScope() {
+	currentContext = previous;
+	currentMutex = previousMutex;
+}
+
+ASTContext* getCurrentASTContext() {
+	return currentContext;
+}
+
+std::unique_lock<std::mutex> lockASTContext() {
+	return currentMutex != nullptr ? std::unique_lock<std::mutex>(*currentMutex) : std::unique_lock<std::mutex>();
+}
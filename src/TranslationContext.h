@@ -0,0 +1,28 @@
+#pragma once
+#include "clang/AST/ASTContext.h"
+
+#include <mutex>
+
+using namespace clang;
+
+// AST of translation unit processed by current thread. Statements do not know their context,
+// code which needs source manager or evaluation gets it from here
+class ASTContextScope {
+public:
+	// mutex is given when several threads translate declarations of the same unit
+	explicit ASTContextScope(ASTContext& Context, std::mutex* mutex = nullptr);
+	~ASTContextScope();
+
+	ASTContextScope(const ASTContextScope&) = delete;
+	ASTContextScope& operator=(const ASTContextScope&) = delete;
+private:
+	ASTContext* previous;
+	std::mutex* previousMutex;
+};
+
+// null outside of translation
+ASTContext* getCurrentASTContext();
+
+// AST is read-only after Sema except for caches which clang evaluator and type size queries fill in
+// ASTContext. They are taken under this lock, it is not locked if unit is translated by one thread
+std::unique_lock<std::mutex> lockASTContext();
@@ -0,0 +1,53 @@
+#include "TranslationOptions.h"
+#include "CallRules.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+static TranslationOptions options;
+
+std::string TranslationOptions::getFingerprint() const {
+	std::string fingerprint = "filter=" + headerFilter;
+	// relative directory means other headers from other working directory, key has it as header filter sees it
+	for (const auto& d : translateDirs) {
+		llvm::SmallString<256> dir(d);
+		llvm::sys::fs::make_absolute(dir);
+		llvm::sys::path::remove_dots(dir, true);
+		fingerprint += ";dir=" + std::string(dir.str());
+	}
+	fingerprint += std::string(";vectorize=") + (vectorize ? "1" : "0");
+	fingerprint += std::string(";numpy-arrays=") + (numpyArrays ? "1" : "0");
+	fingerprint += std::string(";slots=") + (slots ? "1" : "0");
+	for (const auto& c : dynamicClasses) {
+		fingerprint += ";dynamic=" + c;
+	}
+	fingerprint += std::string(";fold=") + (foldConstants ? "1" : "0") + (foldedSourceComments ? "c" : "");
+	fingerprint += std::string(";hoist=") + (hoistInvariants ? "1" : "0");
+	fingerprint += ";rules=" + rulesFile + "@" + getCallRulesFingerprint();
+	fingerprint += std::string(";header-modules=") + (headerModules ? "1" : "0");
+	fingerprint += ";backend=" + std::to_string(static_cast<int>(backend));
+	return fingerprint;
+}
+
+std::vector<std::string> TranslationOptions::getModuleImports() const {
+	std::vector<std::string> imports;
+	if (vectorize || numpyArrays) {
+		imports.push_back("import numpy as np");
+	}
+	if (backend == Backend::Numba) {
+		imports.push_back("from numba import njit");
+	}
+	return imports;
+}
+
+std::string TranslationOptions::getOutputExtension() const {
+	return backend == Backend::Cython ? ".pyx" : ".py";
+}
+
+const TranslationOptions& getTranslationOptions() {
+	return options;
+}
+
+void setTranslationOptions(TranslationOptions newOptions) {
+	options = std::move(newOptions);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// python dialect of generated code
+enum class Backend {
+	Python,
+	// free functions with typed signatures are compiled by numba @njit
+	Numba,
+	// .pyx modules with cdef typed locals, arguments and cdef class fields
+	Cython,
+};
+
+// translator settings. They are set once from command line before translation starts
+// and only read by visitors afterwards
+struct TranslationOptions {
+	// regex for headers translated together with main file
+	std::string headerFilter;
+	// directories with headers translated together with main file.
+	// If both filters are empty every non-system header is translated
+	std::vector<std::string> translateDirs;
+	// element-wise counted loops are written as numpy slice expressions
+	bool vectorize = false;
+	Backend backend = Backend::Python;
+	// local numeric containers are numpy arrays instead of lists
+	bool numpyArrays = false;
+	// classes are emitted with __slots__ of their fields
+	bool slots = true;
+	// classes which get attributes dynamically, they keep __dict__
+	std::vector<std::string> dynamicClasses;
+	// expressions evaluated by clang at compile time are written as literals
+	bool foldConstants = true;
+	// folded literal is followed by comment with its c++ source
+	bool foldedSourceComments = false;
+	// invariant attribute chains, bound methods and lengths are assigned to locals before loops
+	bool hoistInvariants = false;
+	// json file with call rules which extend and override embedded ones
+	std::string rulesFile;
+	// declarations of headers are written to modules of their own and imported by main files
+	bool headerModules = false;
+	// threads translating top-level declarations of one unit, 0 = all cores.
+	// Output does not depend on it
+	unsigned declThreads = 1;
+
+	// all options which change generated code, part of translation cache key
+	std::string getFingerprint() const;
+	// imports written at the beginning of every python module
+	std::vector<std::string> getModuleImports() const;
+	// extension of generated files
+	std::string getOutputExtension() const;
+};
+
+const TranslationOptions& getTranslationOptions();
+void setTranslationOptions(TranslationOptions options);
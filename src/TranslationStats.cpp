@@ -0,0 +1,306 @@
+#include "TranslationStats.h"
+#include "OutputSink.h"
+
+#include "clang/AST/Expr.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<bool> isEnabled{ false };
+static Clock::time_point startTime;
+
+// allocations of current thread, counted by operator new of executables (AllocationCounter.cpp)
+static thread_local uint64_t allocations = 0;
+
+namespace {
+
+struct PhaseStats {
+	Clock::duration time{};
+	uint64_t allocations = 0;
+};
+
+// node counters keep class name from first counted node
+struct NodeCounter {
+	const char* name = nullptr;
+	uint64_t count = 0;
+};
+
+// stats of one thread. Owned by registry, so they survive worker threads of pool
+struct ThreadStats {
+	std::array<PhaseStats, static_cast<size_t>(Phase::Count)> phases;
+	std::array<NodeCounter, Decl::lastDecl + 1> decls;
+	std::array<NodeCounter, Stmt::lastStmtConstant + 1> stmts;
+
+	Phase current = Phase::Other;
+	Clock::time_point lastSwitch;
+	uint64_t lastAllocations = 0;
+};
+
+class StatsRegistry {
+public:
+	ThreadStats* create() {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.push_back(std::make_unique<ThreadStats>());
+		return threads.back().get();
+	}
+
+	template<class F>
+	void forEach(F f) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& t : threads) {
+			f(*t);
+		}
+	}
+private:
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadStats>> threads;
+};
+
+StatsRegistry& getRegistry() {
+	static StatsRegistry registry;
+	return registry;
+}
+
+ThreadStats& getThreadStats() {
+	static thread_local ThreadStats* stats = getRegistry().create();
+	return *stats;
+}
+
+// close interval of current phase
+void switchPhase(ThreadStats& stats, Phase next) {
+	auto now = Clock::now();
+	if (stats.current != Phase::Other) {
+		auto& phase = stats.phases[static_cast<size_t>(stats.current)];
+		phase.time += now - stats.lastSwitch;
+		phase.allocations += allocations - stats.lastAllocations;
+	}
+	stats.current = next;
+	stats.lastSwitch = now;
+	stats.lastAllocations = allocations;
+}
+
+// sum of all threads
+struct RunStats {
+	std::array<PhaseStats, static_cast<size_t>(Phase::Count)> phases;
+	std::map<std::string, uint64_t> decls;
+	std::map<std::string, uint64_t> stmts;
+	std::map<std::string, uint64_t> exprs;
+};
+
+RunStats collectStats() {
+	RunStats run;
+	getRegistry().forEach([&run](const ThreadStats& t) {
+		for (size_t i = 0; i < t.phases.size(); i++) {
+			run.phases[i].time += t.phases[i].time;
+			run.phases[i].allocations += t.phases[i].allocations;
+		}
+		for (const auto& d : t.decls) {
+			if (d.count != 0) run.decls[d.name] += d.count;
+		}
+		for (size_t i = 0; i < t.stmts.size(); i++) {
+			const auto& s = t.stmts[i];
+			if (s.count == 0) continue;
+
+			bool isExpr = i >= Stmt::firstExprConstant && i <= Stmt::lastExprConstant;
+			(isExpr ? run.exprs : run.stmts)[s.name] += s.count;
+		}
+	});
+	return run;
+}
+
+}
+
+uint64_t getPeakMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		// kilobytes on linux
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+	}
+	return 0;
+#endif
+}
+
+namespace {
+
+double toMilliseconds(Clock::duration d) {
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void printCounts(llvm::raw_ostream& out, const char* title, const std::map<std::string, uint64_t>& counts) {
+	if (counts.empty()) return;
+
+	out << title << ":\n";
+	for (const auto& [name, count] : counts) {
+		out << llvm::format("  %-32s %10llu\n", name.c_str(), static_cast<unsigned long long>(count));
+	}
+}
+
+llvm::json::Object toJson(const std::map<std::string, uint64_t>& counts) {
+	llvm::json::Object object;
+	for (const auto& [name, count] : counts) {
+		object[name] = static_cast<int64_t>(count);
+	}
+	return object;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const char* getPhaseName(Phase phase) {
+	switch (phase) {
+	case Phase::Frontend: return "frontend";
+	case Phase::Preamble: return "preamble";
+	case Phase::Declarations: return "declarations";
+	case Phase::Statements: return "statements";
+	case Phase::Expressions: return "expressions";
+	case Phase::Emission: return "emission";
+	default: return "other";
+	}
+}
+
+void enableStats() {
+	startTime = Clock::now();
+	isEnabled = true;
+}
+
+bool isStatsEnabled() {
+	return isEnabled.load(std::memory_order_relaxed);
+}
+
+void countAllocation() {
+	if (isStatsEnabled()) {
+		allocations++;
+	}
+}
+
+PhaseScope::PhaseScope(Phase phase)
+	: previous(Phase::Other), isActive(isStatsEnabled()) {
+	if (!isActive) return;
+
+	auto& stats = getThreadStats();
+	previous = stats.current;
+	switchPhase(stats, phase);
+}
+
+PhaseScope::~PhaseScope() {
+	if (!isActive) return;
+
+	switchPhase(getThreadStats(), previous);
+}
+
+void countNode(const Decl* D) {
+	if (!isStatsEnabled() || D == nullptr) return;
+
+	auto& counter = getThreadStats().decls[D->getKind()];
+	counter.name = D->getDeclKindName();
+	counter.count++;
+}
+
+void countNode(const Stmt* S) {
+	if (!isStatsEnabled() || S == nullptr) return;
+
+	auto& counter = getThreadStats().stmts[S->getStmtClass()];
+	counter.name = S->getStmtClassName();
+	counter.count++;
+}
+
+PhaseTotals getPhaseTotals(Phase phase) {
+	PhaseTotals totals;
+	getRegistry().forEach([&totals, phase](const ThreadStats& t) {
+		const auto& p = t.phases[static_cast<size_t>(phase)];
+		totals.milliseconds += toMilliseconds(p.time);
+		totals.allocations += p.allocations;
+	});
+	return totals;
+}
+
+void resetStats() {
+	getRegistry().forEach([](ThreadStats& t) {
+		t.phases = {};
+		t.decls = {};
+		t.stmts = {};
+	});
+	startTime = Clock::now();
+}
+
+void printTimeReport(llvm::raw_ostream& out) {
+	auto run = collectStats();
+
+	// times are summed over threads, so with -j they may exceed wall time
+	out << "===---------------------------------------------------------===\n";
+	out << "                    cpp2python time report\n";
+	out << "===---------------------------------------------------------===\n";
+	out << llvm::format("  %-16s %12s %14s\n", "phase", "time, ms", "allocations");
+	for (size_t i = 1; i < run.phases.size(); i++) {
+		out << llvm::format("  %-16s %12.1f %14llu\n", getPhaseName(static_cast<Phase>(i)),
+			toMilliseconds(run.phases[i].time), static_cast<unsigned long long>(run.phases[i].allocations));
+	}
+	out << llvm::format("  %-16s %12.1f\n", "wall", toMilliseconds(Clock::now() - startTime));
+	out << llvm::format("  peak memory: %.1f MiB\n", getPeakMemory() / (1024.0 * 1024.0));
+
+	printCounts(out, "declarations", run.decls);
+	printCounts(out, "statements", run.stmts);
+	printCounts(out, "expressions", run.exprs);
+}
+
+bool writeStatsJson(const std::string& path) {
+	auto run = collectStats();
+
+	llvm::json::Object phases;
+	for (size_t i = 1; i < run.phases.size(); i++) {
+		phases[getPhaseName(static_cast<Phase>(i))] = llvm::json::Object{
+			{ "ms", toMilliseconds(run.phases[i].time) },
+			{ "allocations", static_cast<int64_t>(run.phases[i].allocations) },
+		};
+	}
+
+	llvm::json::Object root{
+		{ "wall_ms", toMilliseconds(Clock::now() - startTime) },
+		{ "peak_memory", static_cast<int64_t>(getPeakMemory()) },
+		{ "phases", std::move(phases) },
+		{ "declarations", toJson(run.decls) },
+		{ "statements", toJson(run.stmts) },
+		{ "expressions", toJson(run.exprs) },
+	};
+
+	std::error_code ec;
+	llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_Text);
+	if (ec) {
+		llvm::errs() << "cannot write stats to " << path << ": " << ec.message() << "\n";
+		return false;
+	}
+	out << llvm::formatv("{0:2}", llvm::json::Value(std::move(root))) << "\n";
+	return closeFileSink(out, path);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "clang/AST/DeclBase.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <string>
+
+using namespace clang;
+
+// parts of translation measured by --time-report / --stats-json
+enum class Phase {
+	Other,
+	// preprocessing, parsing and Sema of main file
+	Frontend,
+	// building of shared precompiled preamble
+	Preamble,
+	Declarations,
+	Statements,
+	Expressions,
+	// writing of python code to sinks
+	Emission,
+	Count
+};
+
+const char* getPhaseName(Phase phase);
+
+// statistics are collected only after enableStats(), otherwise scopes and counters do nothing
+void enableStats();
+bool isStatsEnabled();
+
+// called by replaced operator new, which is linked only into executables (AllocationCounter.cpp)
+void countAllocation();
+
+// time and allocations inside of scope are added to given phase of current thread.
+// Phases are exclusive: nested scope pauses its parent, so every moment is counted once
+class PhaseScope {
+public:
+	explicit PhaseScope(Phase phase);
+	~PhaseScope();
+
+	PhaseScope(const PhaseScope&) = delete;
+	PhaseScope& operator=(const PhaseScope&) = delete;
+private:
+	Phase previous;
+	bool isActive;
+};
+
+// number of translated nodes per class
+void countNode(const Decl* D);
+void countNode(const Stmt* S);
+
+// totals of all threads for one phase, used by benchmark
+struct PhaseTotals {
+	double milliseconds = 0;
+	uint64_t allocations = 0;
+};
+PhaseTotals getPhaseTotals(Phase phase);
+uint64_t getPeakMemory();
+// forget collected times and counts. Must not be called while translation runs
+void resetStats();
+
+// per-phase table, node counts and memory of whole run
+void printTimeReport(llvm::raw_ostream& out);
+bool writeStatsJson(const std::string& path);
@@ -0,0 +1,311 @@
+#include "TranslationUnitAction.h"
+#include "CallRules.h"
+#include "DeclarationVisitor.h"
+#include "ClassLayout.h"
+#include "ContainerLowering.h"
+#include "HeaderFilter.h"
+#include "Lines.h"
+#include "TranslationContext.h"
+#include "TranslationStats.h"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/xxhash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+
+// translates top-level declarations accepted by header filter. Only they are visited,
+// bodies of all other functions are not even parsed
+class TranslationUnitConsumer : public clang::ASTConsumer {
+public:
+	TranslationUnitConsumer(const SourceManager& SM, OutputSink& out, HeaderModuleRegistry* modules)
+		: SM(SM), filter(SM, getTranslationOptions()), out(out), modules(modules) {}
+
+	bool shouldSkipFunctionBody(Decl* D) override {
+		return !filter.isTranslated(D->getLocation());
+	}
+
+	void HandleTranslationUnit(clang::ASTContext &Context) override {
+		ASTContextScope context(Context);
+		resetContainerAnalysis();
+		scanClassLayouts(Context.getTranslationUnitDecl());
+
+		std::vector<const Decl*> decls;
+		for (auto* d : Context.getTranslationUnitDecl()->decls()) {
+			if (filter.isTranslated(d->getBeginLoc())) {
+				decls.push_back(d);
+			}
+		}
+
+		std::vector<std::string> headerImports;
+		if (modules != nullptr) {
+			decls = translateHeaderModules(Context, decls, headerImports);
+		}
+
+		// imports of call rules are collected before translation, declarations are written right after it
+		auto imports = collectRuleImports(decls);
+		imports.insert(imports.end(), headerImports.begin(), headerImports.end());
+		writeModuleHeader(out, std::move(imports));
+		translateDecls(Context, decls, out);
+	}
+private:
+	const SourceManager& SM;
+	HeaderFilter filter;
+	OutputSink& out;
+	HeaderModuleRegistry* modules;
+
+	// top-level declarations of one header
+	struct HeaderDecls {
+		FileID file;
+		std::string path;
+		std::vector<const Decl*> decls;
+	};
+
+	void translateDecls(ASTContext& Context, const std::vector<const Decl*>& decls, OutputSink& out) {
+		auto threads = getTranslationOptions().declThreads;
+		// declarations of preamble or pch are deserialized lazily, that is not thread-safe
+		if (threads != 1 && decls.size() > 1 && Context.getExternalSource() == nullptr) {
+			translateParallel(Context, decls, threads, out);
+		}
+		else {
+			for (const auto* d : decls) {
+				DeclarationVisitor v(d);
+				writeDecl(v.takeLines(), out);
+			}
+		}
+	}
+
+	// lines of declaration are dropped as soon as they are written
+	static void writeDecl(LineBuffer lines, OutputSink& out) {
+		PhaseScope phase(Phase::Emission);
+		printLines(lines, out);
+		out << "\n";
+	}
+
+	// header is included by given file directly or through other headers (as it was entered first time)
+	bool isIncludedBy(FileID header, FileID includer) const {
+		for (auto loc = SM.getIncludeLoc(header); loc.isValid(); loc = SM.getIncludeLoc(SM.getFileID(loc))) {
+			if (SM.getFileID(loc) == includer) return true;
+		}
+		return false;
+	}
+
+	// prototype, forward declaration or extern variable: it defines nothing in header module
+	static bool isDeclarationOnly(const Decl* D) {
+		if (const auto* F = dyn_cast<FunctionDecl>(D)) {
+			return !F->doesThisDeclarationHaveABody();
+		}
+		if (const auto* T = dyn_cast<TagDecl>(D)) {
+			return !T->isThisDeclarationADefinition();
+		}
+		if (const auto* V = dyn_cast<VarDecl>(D)) {
+			return V->isThisDeclarationADefinition() == VarDecl::DeclarationOnly;
+		}
+		return false;
+	}
+
+	// class of header with methods defined in other file, e.g. in its .cpp. Its translation depends
+	// on unit which has those definitions, so class stays with units as without header modules
+	bool hasOutsideDefinitions(const Decl* D, FileID header) const {
+		const auto* R = dyn_cast<CXXRecordDecl>(D);
+		if (R == nullptr || !R->isThisDeclarationADefinition()) {
+			return false;
+		}
+		for (const auto* m : R->methods()) {
+			if (m->isImplicit() || m->isPure() || m->isDeleted() || m->isDefaulted()) continue;
+			const FunctionDecl* definition = nullptr;
+			if (!m->hasBody(definition) || SM.getFileID(SM.getExpansionLoc(definition->getLocation())) != header) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// declarations of headers go to modules of their own, each one is written by the first unit
+	// which includes header. Module gets only definitions of header itself, so it is the same whichever
+	// unit writes it. Returns declarations of main file, imports of header modules are added to list
+	std::vector<const Decl*> translateHeaderModules(ASTContext& Context, const std::vector<const Decl*>& decls,
+		std::vector<std::string>& imports) {
+		std::vector<const Decl*> mainDecls;
+		std::vector<HeaderDecls> headers;
+		llvm::DenseMap<FileID, size_t> index;
+		for (const auto* d : decls) {
+			auto id = SM.getFileID(SM.getExpansionLoc(d->getBeginLoc()));
+			const auto* file = SM.getFileEntryForID(id);
+			if (id == SM.getMainFileID() || file == nullptr || hasOutsideDefinitions(d, id)) {
+				mainDecls.push_back(d);
+				continue;
+			}
+			// definitions of functions are translated by units or headers which have them
+			if (isDeclarationOnly(d)) {
+				continue;
+			}
+			auto [it, isNew] = index.try_emplace(id, headers.size());
+			if (isNew) {
+				auto path = file->tryGetRealPathName();
+				headers.push_back({ id, std::string(path.empty() ? file->getName() : path), {} });
+			}
+			headers[it->second].decls.push_back(d);
+		}
+
+		for (const auto& header : headers) {
+			if (auto line = modules->getHeaderImport(header.path, header.decls); !line.empty()) {
+				imports.push_back(std::move(line));
+			}
+			if (!modules->claim(header.path, llvm::xxHash64(SM.getBufferData(header.file)))) {
+				continue;
+			}
+
+			// module imports names of headers which it includes itself
+			std::vector<std::string> moduleImports;
+			for (const auto& other : headers) {
+				if (&other != &header && isIncludedBy(other.file, header.file)) {
+					if (auto line = modules->getHeaderImport(other.path, other.decls); !line.empty()) {
+						moduleImports.push_back(std::move(line));
+					}
+				}
+			}
+
+			auto ruleImports = collectRuleImports(header.decls);
+			moduleImports.insert(moduleImports.begin(), ruleImports.begin(), ruleImports.end());
+
+			std::error_code ec;
+			auto path = modules->getModulePath(modules->getModuleName(header.path));
+			auto file = openFileSink(path, ec);
+			if (!file) {
+				llvm::errs() << "cannot write header module " << path << ": " << ec.message() << "\n";
+				continue;
+			}
+			writeModuleHeader(*file, std::move(moduleImports));
+			translateDecls(Context, header.decls, *file);
+			closeFileSink(*file, path);
+		}
+		return mainDecls;
+	}
+
+	struct TranslatedDecl {
+		LineBuffer lines;
+		bool isReady = false;
+	};
+
+	// workers take chunks of declarations by atomic index, results are merged in source order
+	// and written as soon as they are ready, so output is the same as of serial translation
+	void translateParallel(ASTContext& Context, const std::vector<const Decl*>& decls, unsigned threads, OutputSink& out) {
+		llvm::ThreadPool pool(llvm::hardware_concurrency(threads));
+		auto workers = std::min<size_t>(pool.getThreadCount(), decls.size());
+		// small chunks keep workers balanced, large ones keep them off the shared counter
+		auto chunk = std::clamp<size_t>(decls.size() / (workers * 16), 1, 32);
+
+		std::vector<TranslatedDecl> results(decls.size());
+		std::atomic<size_t> next{ 0 };
+		std::mutex contextMutex;
+		std::mutex readyMutex;
+		std::condition_variable readyChanged;
+
+		for (size_t w = 0; w < workers; w++) {
+			pool.async([&] {
+				// per-unit state of visitors is thread-local
+				ASTContextScope context(Context, &contextMutex);
+				resetContainerAnalysis();
+				scanClassLayouts(Context.getTranslationUnitDecl());
+
+				for (size_t begin = next.fetch_add(chunk); begin < decls.size(); begin = next.fetch_add(chunk)) {
+					auto end = std::min(begin + chunk, decls.size());
+					for (size_t i = begin; i < end; i++) {
+						DeclarationVisitor v(decls[i]);
+						auto lines = v.takeLines();
+
+						std::lock_guard<std::mutex> lock(readyMutex);
+						results[i].lines = std::move(lines);
+						results[i].isReady = true;
+						readyChanged.notify_one();
+					}
+				}
+			});
+		}
+
+		for (auto& result : results) {
+			{
+				std::unique_lock<std::mutex> lock(readyMutex);
+				readyChanged.wait(lock, [&result] { return result.isReady; });
+			}
+			writeDecl(std::move(result.lines), out);
+		}
+		pool.wait();
+	}
+
+	// imports of options followed by given ones
+	static void writeModuleHeader(OutputSink& out, std::vector<std::string> used) {
+		auto imports = getTranslationOptions().getModuleImports();
+		for (auto& i : used) {
+			if (std::find(imports.begin(), imports.end(), i) == imports.end()) imports.push_back(std::move(i));
+		}
+		if (imports.empty()) return;
+
+		PhaseScope phase(Phase::Emission);
+		for (const auto& i : imports) {
+			out << i << "\n";
+		}
+		out << "\n";
+	}
+};
+
+// collects user headers entered by preprocessor
+class IncludeCollector : public PPCallbacks {
+public:
+	IncludeCollector(const SourceManager& SM, std::vector<std::string>& headers)
+		: SM(SM), headers(headers) {}
+
+	void FileChanged(SourceLocation Loc, FileChangeReason Reason, SrcMgr::CharacteristicKind FileType, FileID PrevFID) override {
+		if (Reason != EnterFile || FileType != SrcMgr::C_User) return;
+
+		auto id = SM.getFileID(SM.getExpansionLoc(Loc));
+		const auto* file = SM.getFileEntryForID(id);
+		if (file == nullptr || id == SM.getMainFileID()) return;
+
+		// real path does not depend on working directory of compile command
+		auto path = file->tryGetRealPathName();
+		if (path.empty()) path = file->getName();
+		if (seen.insert(path).second) {
+			headers.push_back(path.str());
+		}
+	}
+private:
+	const SourceManager& SM;
+	std::vector<std::string>& headers;
+	llvm::StringSet<> seen;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+TranslationUnitAction::TranslationUnitAction(OutputSink& out, std::vector<std::string>* headers, HeaderModuleRegistry* modules)
+	: out(out), headers(headers), modules(modules) {}
+
+bool TranslationUnitAction::BeginSourceFileAction(CompilerInstance &Compiler) {
+	// bodies outside of header filter are skipped by consumer
+	Compiler.getFrontendOpts().SkipFunctionBodies = true;
+
+	if (headers != nullptr) {
+		Compiler.getPreprocessor().addPPCallbacks(createIncludeCollector(Compiler.getSourceManager(), *headers));
+	}
+	return true;
+}
+
+void TranslationUnitAction::ExecuteAction() {
+	// time of visitors is subtracted from frontend by nested phases
+	PhaseScope phase(Phase::Frontend);
+	ASTFrontendAction::ExecuteAction();
+}
+
+std::unique_ptr<ASTConsumer> TranslationUnitAction::CreateASTConsumer(CompilerInstance &Compiler, llvm::StringRef InFile) {
+	return std::make_unique<TranslationUnitConsumer>(Compiler.getSourceManager(), out, modules);
+}
+
+std::unique_ptr<PPCallbacks> createIncludeCollector(const SourceManager& SM, std::vector<std::string>& headers) {
+	return std::make_unique<IncludeCollector>(SM, headers);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "OutputSink.h"
+#include "HeaderModules.h"
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+// translate every non-system declaration of TU and write python code to given sink.
+// Declarations are written as soon as they are translated, whole TU is never kept in memory:
+// imports of call rules are collected from calls of TU before the first declaration.
+// If headers is given, absolute paths of all non-system files included by TU are added to it.
+// If modules are given, declarations of headers are written to header modules and imported
+class TranslationUnitAction : public ASTFrontendAction {
+public:
+	explicit TranslationUnitAction(OutputSink& out, std::vector<std::string>* headers = nullptr,
+		HeaderModuleRegistry* modules = nullptr);
+
+	bool BeginSourceFileAction(CompilerInstance& Compiler) override;
+	void ExecuteAction() override;
+	std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& Compiler, llvm::StringRef InFile) override;
+private:
+	OutputSink& out;
+	std::vector<std::string>* headers;
+	HeaderModuleRegistry* modules;
+};
+
+// preprocessor callbacks which add absolute paths of entered user headers to given list
+std::unique_ptr<PPCallbacks> createIncludeCollector(const SourceManager& SM, std::vector<std::string>& headers);
@@ -0,0 +1,266 @@
+#include "TypeMapper.h"
+#include "TranslationContext.h"
+#include "CallRules.h"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/StringSet.h"
+
+static std::optional<std::string> getNumbaScalarType(QualType type, const ASTContext& Context) {
+	type = type.getCanonicalType().getUnqualifiedType();
+	const auto* builtin = type->getAs<BuiltinType>();
+	if (builtin == nullptr) {
+		return std::nullopt;
+	}
+
+	switch (builtin->getKind()) {
+	case BuiltinType::Bool: return "boolean";
+	case BuiltinType::Float: return "float32";
+	case BuiltinType::Double: return "float64";
+	case BuiltinType::Void: return "void";
+	default: break;
+	}
+
+	if (builtin->isInteger()) {
+		auto lock = lockASTContext();
+		auto bits = std::to_string(Context.getTypeSize(type));
+		return (builtin->isSignedInteger() ? "int" : "uint") + bits;
+	}
+	// long double and others have no numba type
+	return std::nullopt;
+}
+
+// element type of std::vector<T>, T[N] or T*
+static std::optional<QualType> getArrayElementType(QualType type) {
+	type = type.getCanonicalType();
+	if (const auto* array = dyn_cast<ArrayType>(type.getTypePtr())) {
+		return array->getElementType();
+	}
+	if (const auto* pointer = type->getAs<PointerType>()) {
+		return pointer->getPointeeType();
+	}
+
+	const auto* record = dyn_cast_or_null<ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+	if (record == nullptr || !record->isInStdNamespace() || record->getName() != "vector") {
+		return std::nullopt;
+	}
+	const auto& args = record->getTemplateArgs();
+	if (args.size() == 0 || args[0].getKind() != TemplateArgument::Type) {
+		return std::nullopt;
+	}
+	return args[0].getAsType();
+}
+
+std::optional<std::string> getNumbaType(QualType type, const ASTContext& Context) {
+	if (const auto* reference = type->getAs<ReferenceType>()) {
+		auto pointee = reference->getPointeeType();
+		// output parameters of scalars cannot be returned through numba arguments
+		if (!pointee.isConstQualified() && pointee->isArithmeticType()) {
+			return std::nullopt;
+		}
+		type = pointee;
+	}
+
+	if (auto element = getArrayElementType(type)) {
+		auto elementType = getNumbaScalarType(*element, Context);
+		if (!elementType || *elementType == "void") {
+			return std::nullopt;
+		}
+		return *elementType + "[:]";
+	}
+	return getNumbaScalarType(type, Context);
+}
+
+std::optional<std::string> getNumpyDtype(QualType type, const ASTContext& Context) {
+	if (type->isBooleanType()) {
+		return "np.bool_";
+	}
+	if (type.getCanonicalType()->isSpecificBuiltinType(BuiltinType::LongDouble)) {
+		return "np.longdouble";
+	}
+	// numba scalar names are numpy ones
+	auto scalar = getNumbaScalarType(type, Context);
+	if (!scalar || *scalar == "void") {
+		return std::nullopt;
+	}
+	return "np." + *scalar;
+}
+
+std::optional<std::string> getCythonType(QualType type, const ASTContext& Context) {
+	type = type.getNonReferenceType().getCanonicalType().getUnqualifiedType();
+	const auto* builtin = type->getAs<BuiltinType>();
+	if (builtin == nullptr) {
+		return std::nullopt;
+	}
+
+	switch (builtin->getKind()) {
+	case BuiltinType::Bool:
+		return "bint";
+	case BuiltinType::Char_S:
+	case BuiltinType::Char_U:
+	case BuiltinType::SChar:
+	case BuiltinType::UChar:
+	case BuiltinType::Short:
+	case BuiltinType::UShort:
+	case BuiltinType::Int:
+	case BuiltinType::UInt:
+	case BuiltinType::Long:
+	case BuiltinType::ULong:
+	case BuiltinType::LongLong:
+	case BuiltinType::ULongLong:
+	case BuiltinType::Float:
+	case BuiltinType::Double:
+	case BuiltinType::LongDouble:
+		return type.getAsString(PrintingPolicy(Context.getLangOpts()));
+	default:
+		return std::nullopt;
+	}
+}
+
+namespace {
+
+// statements and expressions which translator emits as code accepted by numba nopython mode
+class NumbaBodyChecker {
+public:
+	explicit NumbaBodyChecker(const ASTContext& Context)
+		: Context(Context) {}
+
+	bool isSupported(const Stmt* S) const {
+		if (S == nullptr) {
+			return true;
+		}
+
+		switch (S->getStmtClass()) {
+		case Stmt::CompoundStmtClass:
+		case Stmt::IfStmtClass:
+		case Stmt::WhileStmtClass:
+		case Stmt::ForStmtClass:
+		case Stmt::ReturnStmtClass:
+		case Stmt::BreakStmtClass:
+		case Stmt::ContinueStmtClass:
+		case Stmt::NullStmtClass:
+		case Stmt::ConditionalOperatorClass:
+		case Stmt::ParenExprClass:
+		case Stmt::ImplicitCastExprClass:
+		case Stmt::ArraySubscriptExprClass:
+		case Stmt::IntegerLiteralClass:
+		case Stmt::FloatingLiteralClass:
+		case Stmt::CXXBoolLiteralExprClass:
+		case Stmt::ExprWithCleanupsClass:
+			break;
+		case Stmt::BinaryOperatorClass:
+		case Stmt::CompoundAssignOperatorClass:
+			if (!isNumbaOperator(cast<BinaryOperator>(S)->getOpcode())) return false;
+			break;
+		case Stmt::UnaryOperatorClass:
+			if (!isNumbaOperator(cast<UnaryOperator>(S)->getOpcode())) return false;
+			break;
+		case Stmt::CStyleCastExprClass:
+		case Stmt::CXXFunctionalCastExprClass:
+			if (!cast<Expr>(S)->getType()->isArithmeticType()) return false;
+			break;
+		case Stmt::DeclStmtClass:
+			for (const auto* d : cast<DeclStmt>(S)->decls()) {
+				const auto* vd = dyn_cast<VarDecl>(d);
+				if (vd == nullptr || !getNumbaType(vd->getType(), Context) || !isSupported(vd->getInit())) {
+					return false;
+				}
+			}
+			return true;
+		case Stmt::DeclRefExprClass: {
+			const auto* decl = cast<DeclRefExpr>(S)->getDecl();
+			return isa<VarDecl>(decl) || isa<EnumConstantDecl>(decl) || isa<FunctionDecl>(decl);
+		}
+		case Stmt::CallExprClass:
+			if (!isMathCall(cast<CallExpr>(S))) return false;
+			break;
+		case Stmt::CXXOperatorCallExprClass: {
+			// only element access of vector
+			const auto* call = cast<CXXOperatorCallExpr>(S);
+			if (call->getOperator() != OO_Subscript || !getArrayElementType(call->getArg(0)->getType())) return false;
+			return isSupported(call->getArg(0)) && isSupported(call->getArg(1));
+		}
+		case Stmt::CXXMemberCallExprClass: {
+			// v.size() is emitted as len(v)
+			const auto* call = cast<CXXMemberCallExpr>(S);
+			const auto* method = call->getMethodDecl();
+			if (method == nullptr || method->getName() != "size" || !getArrayElementType(call->getObjectType())) return false;
+			return isSupported(call->getImplicitObjectArgument());
+		}
+		default:
+			return false;
+		}
+
+		for (const auto* child : S->children()) {
+			if (!isSupported(child)) {
+				return false;
+			}
+		}
+		return true;
+	}
+private:
+	const ASTContext& Context;
+
+	// arithmetic, comparison and logical operators. Pointer, comma and member pointer ones are not numba code
+	static bool isNumbaOperator(BinaryOperatorKind op) {
+		switch (op) {
+		case BO_Mul: case BO_Div: case BO_Rem: case BO_Add: case BO_Sub:
+		case BO_LT: case BO_GT: case BO_LE: case BO_GE: case BO_EQ: case BO_NE:
+		case BO_LAnd: case BO_LOr:
+		case BO_Assign: case BO_MulAssign: case BO_DivAssign: case BO_RemAssign: case BO_AddAssign: case BO_SubAssign:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool isNumbaOperator(UnaryOperatorKind op) {
+		switch (op) {
+		case UO_PostInc: case UO_PostDec: case UO_PreInc: case UO_PreDec:
+		case UO_Plus: case UO_Minus: case UO_LNot:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// std math functions by the same key as call rules, so user function named sqrt is not taken for math one
+	static bool isMathCall(const CallExpr* C) {
+		static const llvm::StringSet<> functions = {
+			"std::sqrt", "std::exp", "std::log", "std::sin", "std::cos", "std::tan", "std::fabs", "std::abs",
+			"std::pow", "std::floor", "std::ceil",
+		};
+		const auto* f = C->getDirectCallee();
+		return f != nullptr && f->getIdentifier() != nullptr && functions.count(getCallRuleKey(f));
+	}
+};
+
+}
+
+std::optional<std::string> getNumbaSignature(const FunctionDecl* F) {
+	if (isa<CXXMethodDecl>(F) || F->getBody() == nullptr || F->isVariadic() || F->isTemplated()) {
+		return std::nullopt;
+	}
+
+	const auto& Context = F->getASTContext();
+	auto signature = getNumbaType(F->getReturnType(), Context);
+	if (!signature) {
+		return std::nullopt;
+	}
+
+	*signature += "(";
+	for (unsigned i = 0; i < F->getNumParams(); i++) {
+		auto type = getNumbaType(F->getParamDecl(i)->getType(), Context);
+		if (!type || *type == "void") {
+			return std::nullopt;
+		}
+		*signature += (i > 0 ? ", " : "") + *type;
+	}
+	*signature += ")";
+
+	if (!NumbaBodyChecker(Context).isSupported(F->getBody())) {
+		return std::nullopt;
+	}
+	return signature;
+}
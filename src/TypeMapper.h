@@ -0,0 +1,22 @@
+#pragma once
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+
+#include <optional>
+#include <string>
+
+using namespace clang;
+
+// numba type of c++ type: scalars by size, std::vector / c arrays / pointers of scalars
+// as 1d arrays. nullopt if type has no numba equivalent
+std::optional<std::string> getNumbaType(QualType type, const ASTContext& Context);
+
+// numpy dtype of scalar type (np.float64, np.int32, np.bool_)
+std::optional<std::string> getNumpyDtype(QualType type, const ASTContext& Context);
+
+// c type for cython cdef declarations. Only scalars are typed, containers stay python objects
+std::optional<std::string> getCythonType(QualType type, const ASTContext& Context);
+
+// signature for @njit, like "float64(float64[:], int64)". Only free functions with typed
+// parameters and bodies of constructs supported by numba nopython mode have it
+std::optional<std::string> getNumbaSignature(const FunctionDecl* F);
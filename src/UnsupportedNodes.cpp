@@ -0,0 +1,151 @@
+#include "UnsupportedNodes.h"
+#include "OutputSink.h"
+#include "TranslationContext.h"
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <mutex>
+
+// examples kept for every kind
+static const size_t maxLocations = 3;
+
+namespace {
+
+struct UnsupportedKind {
+	const char* category = nullptr;
+	uint64_t count = 0;
+	std::vector<std::string> locations;
+};
+
+class UnsupportedCollector {
+public:
+	void setDumpedKinds(const std::vector<std::string>& kinds) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& k : kinds) {
+			dumpedKinds.insert(k);
+		}
+	}
+
+	// selected kinds are dumped under the same lock, so dumps of parallel workers do not interleave.
+	// Location and dump read source manager of unit, which is shared by its workers
+	template<class Dump>
+	void report(const char* category, llvm::StringRef kind, const SourceManager* SM, SourceLocation Loc, Dump dump) {
+		auto contextLock = lockASTContext();
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& k = kinds[kind];
+		k.category = category;
+		k.count++;
+		total++;
+		if (k.locations.size() < maxLocations && SM != nullptr && Loc.isValid()) {
+			k.locations.push_back(Loc.printToString(*SM));
+		}
+		if (!dumpedKinds.empty() && dumpedKinds.count(kind)) {
+			dump();
+		}
+	}
+
+	size_t getCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return total;
+	}
+
+	std::vector<std::pair<std::string, UnsupportedKind>> getSorted() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<std::pair<std::string, UnsupportedKind>> sorted;
+		for (const auto& k : kinds) {
+			sorted.push_back({ k.getKey().str(), k.getValue() });
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+			return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+		});
+		return sorted;
+	}
+private:
+	std::mutex mutex;
+	llvm::StringMap<UnsupportedKind> kinds;
+	llvm::StringSet<> dumpedKinds;
+	size_t total = 0;
+};
+
+UnsupportedCollector& getCollector() {
+	static UnsupportedCollector collector;
+	return collector;
+}
+
+}
+
+void reportUnsupported(const Decl* D) {
+	const auto& SM = D->getASTContext().getSourceManager();
+	getCollector().report("declaration", D->getDeclKindName(), &SM, D->getLocation(), [D] {
+		D->dump(llvm::errs());
+	});
+}
+
+void reportUnsupported(const Stmt* S) {
+	const auto* context = getCurrentASTContext();
+	const auto* SM = context != nullptr ? &context->getSourceManager() : nullptr;
+	const char* category = isa<Expr>(S) ? "expression" : "statement";
+	getCollector().report(category, S->getStmtClassName(), SM, S->getBeginLoc(), [S, context] {
+		if (context != nullptr) {
+			S->dump(llvm::errs(), *context);
+		}
+		else {
+			S->dump();
+		}
+	});
+}
+
+void setDumpedKinds(const std::vector<std::string>& kinds) {
+	getCollector().setDumpedKinds(kinds);
+}
+
+size_t getUnsupportedCount() {
+	return getCollector().getCount();
+}
+
+void printUnsupportedSummary(llvm::raw_ostream& out) {
+	auto sorted = getCollector().getSorted();
+	if (sorted.empty()) return;
+
+	out << "unsupported nodes: " << getUnsupportedCount() << " of " << sorted.size() << " kinds\n";
+	for (const auto& [name, kind] : sorted) {
+		out << llvm::format("  %8llu  %-11s %-32s", static_cast<unsigned long long>(kind.count), kind.category, name.c_str());
+		if (!kind.locations.empty()) {
+			out << " first at " << kind.locations.front();
+		}
+		out << "\n";
+	}
+}
+
+bool writeUnsupportedJson(const std::string& path) {
+	llvm::json::Array kinds;
+	for (const auto& [name, kind] : getCollector().getSorted()) {
+		llvm::json::Array locations;
+		for (const auto& l : kind.locations) {
+			locations.push_back(l);
+		}
+		kinds.push_back(llvm::json::Object{
+			{ "kind", name },
+			{ "category", kind.category },
+			{ "count", static_cast<int64_t>(kind.count) },
+			{ "locations", std::move(locations) },
+		});
+	}
+
+	std::error_code ec;
+	llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_Text);
+	if (ec) {
+		llvm::errs() << "cannot write unsupported nodes to " << path << ": " << ec.message() << "\n";
+		return false;
+	}
+	out << llvm::formatv("{0:2}", llvm::json::Value(std::move(kinds))) << "\n";
+	return closeFileSink(out, path);
+}
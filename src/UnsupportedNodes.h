@@ -0,0 +1,22 @@
+#pragma once
+#include "clang/AST/DeclBase.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+// nodes which translator cannot process are counted per kind with a few example locations
+// instead of dumping their subtrees. Collector is shared by all worker threads
+void reportUnsupported(const Decl* D);
+void reportUnsupported(const Stmt* S);
+
+// full AST is dumped to stderr only for these kinds (--dump-ast-kinds)
+void setDumpedKinds(const std::vector<std::string>& kinds);
+
+size_t getUnsupportedCount();
+// one line per kind, most frequent first
+void printUnsupportedSummary(llvm::raw_ostream& out);
+bool writeUnsupportedJson(const std::string& path);
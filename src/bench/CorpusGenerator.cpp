@@ -0,0 +1,167 @@
+#include "CorpusGenerator.h"
+
+#include <sstream>
+
+static void writeIndent(std::ostream& out, size_t level) {
+	for (size_t i = 0; i < level; i++) {
+		out << "\t";
+	}
+}
+
+static std::string generateNesting(size_t size) {
+	std::stringstream out;
+	out << "int nested(int x) {\n";
+	out << "\tint total = 0;\n";
+	for (size_t i = 0; i < size; i++) {
+		writeIndent(out, i + 1);
+		if (i % 2 == 0) {
+			out << "for (int i" << i << " = 0; i" << i << " < x; i" << i << "++) {\n";
+		}
+		else {
+			out << "if (total < " << i * 10 << ") {\n";
+		}
+		writeIndent(out, i + 2);
+		out << "total = total + " << i << ";\n";
+	}
+	for (size_t i = size; i > 0; i--) {
+		writeIndent(out, i);
+		out << "}\n";
+	}
+	out << "\treturn total;\n";
+	out << "}\n";
+	return out.str();
+}
+
+static std::string generateWideClass(size_t size) {
+	std::stringstream out;
+	out << "class Wide {\n";
+	out << "public:\n";
+	out << "\tWide(int seed) {\n";
+	for (size_t i = 0; i < size; i++) {
+		out << "\t\tfield" << i << " = seed + " << i << ";\n";
+	}
+	out << "\t}\n";
+	for (size_t i = 0; i < size; i++) {
+		out << "\tint get" << i << "() { return field" << i << " * 2; }\n";
+	}
+	out << "private:\n";
+	for (size_t i = 0; i < size; i++) {
+		out << "\tint field" << i << ";\n";
+	}
+	out << "};\n";
+	return out.str();
+}
+
+static std::string generateExpressionChain(size_t size) {
+	static const char* operators[] = { " + ", " * ", " - ", " / " };
+
+	std::stringstream out;
+	out << "double chain(double a, double b, double c) {\n";
+	out << "\treturn a";
+	for (size_t i = 0; i < size; i++) {
+		out << operators[i % 4] << (i % 3 == 0 ? "b" : i % 3 == 1 ? "(c + 1.5)" : "a");
+		if (i % 8 == 7) {
+			out << "\n\t\t";
+		}
+	}
+	out << ";\n";
+	out << "}\n";
+	return out.str();
+}
+
+// left associative operators of one precedence: parser builds the tree in a loop, so depth is
+// not limited by its stack, and printer needs no parentheses
+static std::string generateDeepExpression(size_t size) {
+	static const char* operators[] = { " + ", " - " };
+
+	std::stringstream out;
+	out << "double deep(double a, double b) {\n";
+	out << "\treturn a";
+	for (size_t i = 0; i < size; i++) {
+		out << operators[i % 2] << (i % 3 == 0 ? "b" : "a");
+		if (i % 8 == 7) {
+			out << "\n\t\t";
+		}
+	}
+	out << ";\n";
+	out << "}\n";
+	return out.str();
+}
+
+static std::string generateManyFunctions(size_t size) {
+	std::stringstream out;
+	for (size_t i = 0; i < size; i++) {
+		out << "int function" << i << "(int a, int b) {\n";
+		out << "\tint c = a * " << i << " + b;\n";
+		out << "\tif (c > " << i << ") {\n";
+		out << "\t\treturn c - b;\n";
+		out << "\t}\n";
+		out << "\treturn c;\n";
+		out << "}\n\n";
+	}
+	return out.str();
+}
+
+static std::string generateLargeEnum(size_t size) {
+	std::stringstream out;
+	out << "enum Large {\n";
+	for (size_t i = 0; i < size; i++) {
+		out << "\tValue" << i << " = " << i * 3 << ",\n";
+	}
+	out << "\tLast\n";
+	out << "};\n\n";
+	out << "int sum() {\n";
+	out << "\tint total = 0;\n";
+	for (size_t i = 0; i < size; i += 16) {
+		out << "\ttotal = total + Value" << i << ";\n";
+	}
+	out << "\treturn total;\n";
+	out << "}\n";
+	return out.str();
+}
+
+const std::vector<CorpusShape>& getAllCorpusShapes() {
+	static const std::vector<CorpusShape> shapes = {
+		CorpusShape::Nesting,
+		CorpusShape::WideClass,
+		CorpusShape::ExpressionChain,
+		CorpusShape::DeepExpression,
+		CorpusShape::ManyFunctions,
+		CorpusShape::LargeEnum,
+	};
+	return shapes;
+}
+
+const char* getCorpusShapeName(CorpusShape shape) {
+	switch (shape) {
+	case CorpusShape::Nesting: return "nesting";
+	case CorpusShape::WideClass: return "wide-class";
+	case CorpusShape::ExpressionChain: return "expression-chain";
+	case CorpusShape::DeepExpression: return "deep-expression";
+	case CorpusShape::ManyFunctions: return "many-functions";
+	case CorpusShape::LargeEnum: return "large-enum";
+	}
+	return "unknown";
+}
+
+bool parseCorpusShape(const std::string& name, CorpusShape& shape) {
+	for (auto s : getAllCorpusShapes()) {
+		if (name == getCorpusShapeName(s)) {
+			shape = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string generateCorpus(CorpusShape shape, size_t size) {
+	switch (shape) {
+	case CorpusShape::Nesting: return generateNesting(size);
+	case CorpusShape::WideClass: return generateWideClass(size);
+	case CorpusShape::ExpressionChain: return generateExpressionChain(size);
+	case CorpusShape::DeepExpression: return generateDeepExpression(size);
+	case CorpusShape::ManyFunctions: return generateManyFunctions(size);
+	case CorpusShape::LargeEnum: return generateLargeEnum(size);
+	}
+	return std::string();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// kinds of synthetic c++ input. Each one stresses other part of translator
+enum class CorpusShape {
+	// ifs and loops nested 'size' levels deep
+	Nesting,
+	// class with 'size' fields, initializing constructor and accessors
+	WideClass,
+	// one expression of 'size' terms
+	ExpressionChain,
+	// one expression of 'size' additions and subtractions, its tree is 'size' levels deep
+	DeepExpression,
+	// 'size' small independent functions
+	ManyFunctions,
+	// enum with 'size' enumerators and function using them
+	LargeEnum,
+};
+
+const std::vector<CorpusShape>& getAllCorpusShapes();
+const char* getCorpusShapeName(CorpusShape shape);
+bool parseCorpusShape(const std::string& name, CorpusShape& shape);
+
+// c++ source of given shape. Code uses only constructions supported by translator
+std::string generateCorpus(CorpusShape shape, size_t size);
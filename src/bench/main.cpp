@@ -0,0 +1,309 @@
+#include "CorpusGenerator.h"
+#include "TranslationStats.h"
+#include "TranslationUnitAction.h"
+
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <map>
+#include <optional>
+
+// translation throughput on generated inputs of growing size. Visitors are measured
+// separately from clang frontend, scaling exponent of each phase shows superlinear hot spots.
+// Every point runs in its own child process, because peak memory of process only grows
+
+static llvm::cl::OptionCategory BenchCategory("cpp2python_bench options");
+
+static llvm::cl::list<std::string> Shapes("shape",
+	llvm::cl::desc("Corpus shape: nesting, wide-class, expression-chain, deep-expression, many-functions, large-enum (default: all)"),
+	llvm::cl::CommaSeparated, llvm::cl::cat(BenchCategory));
+
+static llvm::cl::list<unsigned> Sizes("sizes",
+	llvm::cl::desc("Comma separated corpus sizes (default: 32,64,128,256,512,1024)"),
+	llvm::cl::CommaSeparated, llvm::cl::cat(BenchCategory));
+
+static llvm::cl::opt<unsigned> Repeat("repeat",
+	llvm::cl::desc("Runs per point, the fastest one is reported"),
+	llvm::cl::init(3), llvm::cl::cat(BenchCategory));
+
+static llvm::cl::opt<unsigned> MaxDepth("max-depth",
+	llvm::cl::desc("Limit of nesting depth, deeper sources may overflow parser stack"),
+	llvm::cl::init(256), llvm::cl::cat(BenchCategory));
+
+static llvm::cl::opt<std::string> CsvPath("csv",
+	llvm::cl::desc("Write measurements to CSV file (default: stdout)"),
+	llvm::cl::value_desc("file"), llvm::cl::cat(BenchCategory));
+
+static llvm::cl::opt<double> MaxExponent("max-exponent",
+	llvm::cl::desc("Phases which grow faster than size^x are reported as superlinear"),
+	llvm::cl::init(1.3), llvm::cl::cat(BenchCategory));
+
+// child process measures one point and writes it to json file for parent
+static llvm::cl::opt<std::string> PointShape("point-shape", llvm::cl::ReallyHidden);
+static llvm::cl::opt<unsigned> PointSize("point-size", llvm::cl::ReallyHidden);
+static llvm::cl::opt<std::string> PointOutput("point-output", llvm::cl::ReallyHidden);
+
+static const Phase measuredPhases[] = {
+	Phase::Frontend, Phase::Declarations, Phase::Statements, Phase::Expressions, Phase::Emission
+};
+
+struct Measurement {
+	PhaseTotals phases[std::size(measuredPhases)];
+	double totalMilliseconds = 0;
+	uint64_t peakMemory = 0;
+};
+
+static std::optional<Measurement> measure(const std::string& code) {
+	std::optional<Measurement> best;
+	for (unsigned r = 0; r < std::max(1u, unsigned(Repeat)); r++) {
+		llvm::raw_null_ostream out;
+		resetStats();
+		auto start = std::chrono::steady_clock::now();
+		bool isTranslated = clang::tooling::runToolOnCodeWithArgs(std::make_unique<TranslationUnitAction>(out), code,
+			{ "-std=c++17", "-fbracket-depth=100000" }, "bench.cpp");
+		auto finish = std::chrono::steady_clock::now();
+		if (!isTranslated) {
+			return std::nullopt;
+		}
+
+		Measurement m;
+		for (size_t i = 0; i < std::size(measuredPhases); i++) {
+			m.phases[i] = getPhaseTotals(measuredPhases[i]);
+		}
+		m.totalMilliseconds = std::chrono::duration<double, std::milli>(finish - start).count();
+		if (!best || m.totalMilliseconds < best->totalMilliseconds) {
+			best = m;
+		}
+	}
+	return best;
+}
+
+static bool writePoint(const Measurement& m, const std::string& path) {
+	std::error_code ec;
+	auto file = openFileSink(path, ec);
+	if (!file) {
+		llvm::errs() << "cannot open " << path << ": " << ec.message() << "\n";
+		return false;
+	}
+
+	llvm::json::Array phases;
+	for (const auto& p : m.phases) {
+		phases.push_back(llvm::json::Object{
+			{ "ms", p.milliseconds },
+			{ "allocations", static_cast<int64_t>(p.allocations) },
+		});
+	}
+	*file << llvm::json::Value(llvm::json::Object{
+		{ "total_ms", m.totalMilliseconds },
+		{ "peak_rss_bytes", static_cast<int64_t>(m.peakMemory) },
+		{ "phases", std::move(phases) },
+	});
+	return closeFileSink(*file, path);
+}
+
+static std::optional<Measurement> readPoint(const std::string& path) {
+	auto buffer = llvm::MemoryBuffer::getFile(path);
+	if (!buffer) {
+		return std::nullopt;
+	}
+	auto root = llvm::json::parse((*buffer)->getBuffer());
+	if (!root) {
+		llvm::consumeError(root.takeError());
+		return std::nullopt;
+	}
+	const auto* object = root->getAsObject();
+	const auto* phases = object ? object->getArray("phases") : nullptr;
+	if (phases == nullptr || phases->size() != std::size(measuredPhases)) {
+		return std::nullopt;
+	}
+
+	Measurement m;
+	m.totalMilliseconds = object->getNumber("total_ms").getValueOr(0);
+	m.peakMemory = static_cast<uint64_t>(object->getInteger("peak_rss_bytes").getValueOr(0));
+	for (size_t i = 0; i < phases->size(); i++) {
+		const auto* phase = (*phases)[i].getAsObject();
+		if (phase == nullptr) {
+			return std::nullopt;
+		}
+		m.phases[i].milliseconds = phase->getNumber("ms").getValueOr(0);
+		m.phases[i].allocations = static_cast<uint64_t>(phase->getInteger("allocations").getValueOr(0));
+	}
+	return m;
+}
+
+// translation of one point in this process, run by child
+static int runPoint() {
+	CorpusShape shape;
+	if (!parseCorpusShape(PointShape, shape)) {
+		llvm::errs() << "unknown corpus shape: " << PointShape << "\n";
+		return 1;
+	}
+	enableStats();
+	auto m = measure(generateCorpus(shape, PointSize));
+	if (!m) {
+		return 1;
+	}
+	m->peakMemory = getPeakMemory();
+	return writePoint(*m, PointOutput) ? 0 : 1;
+}
+
+// the same executable is started again for one point, so peak memory belongs to this point only
+static std::optional<Measurement> measureInChild(const std::string& executable, CorpusShape shape, unsigned size) {
+	llvm::SmallString<128> output;
+	if (llvm::sys::fs::createTemporaryFile("cpp2python-bench", "json", output)) {
+		return std::nullopt;
+	}
+
+	std::vector<std::string> args = {
+		executable,
+		"--point-shape=" + std::string(getCorpusShapeName(shape)),
+		"--point-size=" + std::to_string(size),
+		"--point-output=" + std::string(output.str()),
+		"--repeat=" + std::to_string(Repeat),
+	};
+	std::vector<llvm::StringRef> argRefs(args.begin(), args.end());
+	std::string error;
+	int result = llvm::sys::ExecuteAndWait(executable, argRefs, llvm::None, {}, 0, 0, &error);
+
+	std::optional<Measurement> m;
+	if (result == 0) {
+		m = readPoint(std::string(output.str()));
+	}
+	else if (!error.empty()) {
+		llvm::errs() << error << "\n";
+	}
+	llvm::sys::fs::remove(output);
+	return m;
+}
+
+// slope of least squares line through (log lines, log time)
+static std::optional<double> getScalingExponent(const std::vector<std::pair<double, double>>& points) {
+	std::vector<std::pair<double, double>> logs;
+	for (const auto& [x, y] : points) {
+		if (x > 0 && y > 0) logs.push_back({ std::log(x), std::log(y) });
+	}
+	if (logs.size() < 2) {
+		return std::nullopt;
+	}
+
+	double mx = 0, my = 0;
+	for (const auto& [x, y] : logs) {
+		mx += x;
+		my += y;
+	}
+	mx /= logs.size();
+	my /= logs.size();
+
+	double sxy = 0, sxx = 0;
+	for (const auto& [x, y] : logs) {
+		sxy += (x - mx) * (y - my);
+		sxx += (x - mx) * (x - mx);
+	}
+	if (sxx == 0) {
+		return std::nullopt;
+	}
+	return sxy / sxx;
+}
+
+int main(int argc, char** argv) {
+	llvm::cl::HideUnrelatedOptions(BenchCategory);
+	llvm::cl::ParseCommandLineOptions(argc, argv, "cpp2python translation benchmark\n");
+	if (!PointOutput.empty()) {
+		return runPoint();
+	}
+	auto executable = llvm::sys::fs::getMainExecutable(argv[0], reinterpret_cast<void*>(&runPoint));
+
+	std::vector<CorpusShape> shapes;
+	for (const auto& name : Shapes) {
+		CorpusShape shape;
+		if (!parseCorpusShape(name, shape)) {
+			llvm::errs() << "unknown corpus shape: " << name << "\n";
+			return 1;
+		}
+		shapes.push_back(shape);
+	}
+	if (shapes.empty()) {
+		shapes = getAllCorpusShapes();
+	}
+
+	std::vector<unsigned> sizes(Sizes.begin(), Sizes.end());
+	if (sizes.empty()) {
+		sizes = { 32, 64, 128, 256, 512, 1024 };
+	}
+
+	std::unique_ptr<llvm::raw_fd_ostream> file;
+	if (!CsvPath.empty()) {
+		std::error_code ec;
+		file = std::make_unique<llvm::raw_fd_ostream>(CsvPath, ec, llvm::sys::fs::OF_Text);
+		if (ec) {
+			llvm::errs() << "cannot open " << CsvPath << ": " << ec.message() << "\n";
+			return 1;
+		}
+	}
+	auto& csv = file ? *file : llvm::outs();
+	csv << "shape,size,lines,phase,ms,lines_per_sec,allocations,peak_rss_bytes\n";
+
+	bool isSuperlinear = false;
+	for (auto shape : shapes) {
+		// clamped sizes repeat, while fit needs distinct points
+		std::vector<unsigned> shapeSizes;
+		for (auto size : sizes) {
+			if (shape == CorpusShape::Nesting) {
+				size = std::min(size, unsigned(MaxDepth));
+			}
+			if (std::find(shapeSizes.begin(), shapeSizes.end(), size) == shapeSizes.end()) {
+				shapeSizes.push_back(size);
+			}
+		}
+
+		// phase -> (lines, ms) for scaling fit
+		std::map<Phase, std::vector<std::pair<double, double>>> curves;
+		for (auto size : shapeSizes) {
+			auto code = generateCorpus(shape, size);
+			auto lines = std::count(code.begin(), code.end(), '\n');
+
+			auto m = measureInChild(executable, shape, size);
+			if (!m) {
+				llvm::errs() << "cannot translate " << getCorpusShapeName(shape) << " of size " << size << "\n";
+				continue;
+			}
+
+			auto peak = m->peakMemory;
+			for (size_t i = 0; i < std::size(measuredPhases); i++) {
+				const auto& p = m->phases[i];
+				double linesPerSecond = p.milliseconds > 0 ? lines * 1000.0 / p.milliseconds : 0;
+				csv << getCorpusShapeName(shape) << "," << size << "," << lines << "," << getPhaseName(measuredPhases[i]) << ","
+					<< llvm::format("%.3f", p.milliseconds) << "," << llvm::format("%.0f", linesPerSecond) << ","
+					<< p.allocations << "," << peak << "\n";
+				curves[measuredPhases[i]].push_back({ double(lines), p.milliseconds });
+			}
+		}
+
+		llvm::errs() << getCorpusShapeName(shape) << ":\n";
+		for (auto phase : measuredPhases) {
+			auto exponent = getScalingExponent(curves[phase]);
+			if (!exponent) continue;
+
+			llvm::errs() << llvm::format("  %-14s time ~ lines^%.2f", getPhaseName(phase), *exponent);
+			if (*exponent > MaxExponent) {
+				llvm::errs() << "  <- superlinear";
+				isSuperlinear = true;
+			}
+			llvm::errs() << "\n";
+		}
+	}
+	if (file && !closeFileSink(*file, CsvPath)) {
+		return 1;
+	}
+	return isSuperlinear ? 2 : 0;
+}
@@ -0,0 +1,33 @@
+# plots scaling curves from cpp2python_bench CSV:
+#   cpp2python_bench --csv=bench.csv && python plot_scaling.py bench.csv
+import csv
+import sys
+from collections import defaultdict
+
+import matplotlib.pyplot as plt
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "bench.csv"
+    curves = defaultdict(lambda: defaultdict(list))
+    with open(path, newline="") as f:
+        for row in csv.DictReader(f):
+            curves[row["shape"]][row["phase"]].append((int(row["lines"]), float(row["ms"])))
+
+    fig, axes = plt.subplots(1, len(curves), figsize=(5 * len(curves), 4), squeeze=False)
+    for ax, (shape, phases) in zip(axes[0], sorted(curves.items())):
+        for phase, points in sorted(phases.items()):
+            points.sort()
+            ax.plot([p[0] for p in points], [p[1] for p in points], marker="o", label=phase)
+        ax.set_title(shape)
+        ax.set_xscale("log")
+        ax.set_yscale("log")
+        ax.set_xlabel("source lines")
+        ax.set_ylabel("ms")
+        ax.legend()
+    fig.tight_layout()
+    plt.savefig(path.rsplit(".", 1)[0] + ".png")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,89 +1,247 @@
-#include <clang-c/Index.h>
-#include "clang/AST/ASTConsumer.h"
-#include "clang/AST/RecursiveASTVisitor.h"
-#include "clang/Frontend/CompilerInstance.h"
-#include "clang/Frontend/FrontendAction.h"
-#include "clang/Tooling/Tooling.h"
-
-#include "StatementVisitor.h"
-#include "DeclarationVisitor.h"
-#include "Lines.h"
-
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <optional>
-
-using namespace clang;
-
-class TranslationUnitVisitor
-	: public RecursiveASTVisitor<TranslationUnitVisitor> {
-public:
-	explicit TranslationUnitVisitor(ASTContext *Context)
-		: Context(Context) {}
-
-	bool VisitDecl(Decl* D) {
-		if (D->getKind() == Decl::Kind::TranslationUnit) {
-			//llvm::outs() << "Transation unit found\n";
-			auto* unit = D->getTranslationUnitDecl();
-			if (!unit) return true;
-
-			for (auto* d : unit->decls()) {
-				std::optional<std::string> position;
-				FullSourceLoc FullLocation = Context->getFullLoc(d->getBeginLoc());
-				if (FullLocation.isValid() && !FullLocation.isInSystemHeader()) {
-					std::stringstream str;
-					str << FullLocation.getSpellingLineNumber() << ":"
-					<< FullLocation.getSpellingColumnNumber();
-					position = str.str();
-				}
-				else {
-					continue;
-				}
-
-				//llvm::outs() << "# Declated something at " << *position << " with type " << d->getDeclKindName() << "\n";
-				DeclarationVisitor v(d);
-				printLines(v.getLines());
-				std::cout << std::endl;
-			}
-		}
-		return true;
-	}
-private:
-	ASTContext *Context;
-};
-
-class TranslationUnitConsumer : public clang::ASTConsumer {
-public:
-	explicit TranslationUnitConsumer(ASTContext *Context)
-		: Visitor(Context) {}
-
-	virtual void HandleTranslationUnit(clang::ASTContext &Context) {
-		Visitor.TraverseDecl(Context.getTranslationUnitDecl());
-	}
-private:
-	TranslationUnitVisitor Visitor;
-};
-
-class TranslationUnitAction : public clang::ASTFrontendAction {
-public:
-	virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance &Compiler, llvm::StringRef InFile) {
-		return std::make_unique<TranslationUnitConsumer>(&Compiler.getASTContext());
-	}
-};
-
-int main(int argc, char **argv) {
-	if (argc > 1) {
-		std::stringstream str;
-		std::ifstream fin(argv[1]);
-		std::string s;
-		while (!fin.eof()) {
-			std::getline(fin, s);
-			str << s << "\n";
-		}
-		clang::tooling::runToolOnCode(std::make_unique<TranslationUnitAction>(), str.str(), argv[1]);
-	}
-	else {
-		llvm::outs() << "need to set file name";
-	}
-}
\ No newline at end of file
+#include "BatchTranslator.h"
+#include "CallRules.h"
+#include "HeaderModules.h"
+#include "TranslationCache.h"
+#include "PreambleCache.h"
+#include "Server.h"
+#include "TranslationOptions.h"
+#include "TranslationStats.h"
+#include "UnsupportedNodes.h"
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <filesystem>
+#include <iostream>
+
+static llvm::cl::OptionCategory Cpp2PythonCategory("cpp2python options");
+
+static llvm::cl::list<std::string> InputPaths(llvm::cl::Positional, llvm::cl::ZeroOrMore,
+	llvm::cl::desc("<file or directory> ... (- to read single file from stdin)"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> OutputDir("o",
+	llvm::cl::desc("Directory for python files (one .py per source). By default .py is written next to source"),
+	llvm::cl::value_desc("dir"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<unsigned> Jobs("j",
+	llvm::cl::desc("Number of worker threads for batch mode (0 = all cores)"),
+	llvm::cl::init(0), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> BuildPath("p",
+	llvm::cl::desc("Build directory with compile_commands.json. Sources are parsed with their compile commands; "
+		"without input paths every file of the database is translated"),
+	llvm::cl::value_desc("build dir"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> CacheDir("cache-dir",
+	llvm::cl::desc("Directory of persistent translation cache. Unchanged files (with their headers and flags) "
+		"are not parsed again"),
+	llvm::cl::value_desc("dir"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> Server("server",
+	llvm::cl::desc("Stay resident and translate files requested as JSON lines on stdin, responses are written "
+		"to stdout. Compile commands, headers and preambles are kept loaded between requests"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> NoPreamble("no-preamble",
+	llvm::cl::desc("Do not share precompiled preambles between files with the same #include block"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> HeaderFilterRegex("header-filter",
+	llvm::cl::desc("Regular expression for headers which are translated together with main file. "
+		"Bodies of functions from other files are not parsed"),
+	llvm::cl::value_desc("regex"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::list<std::string> TranslateDirs("translate-dir",
+	llvm::cl::desc("Directory with headers which are translated together with main file (may be repeated)"),
+	llvm::cl::value_desc("dir"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> TimeReport("time-report",
+	llvm::cl::desc("Print time and allocations of translation phases, node counts and peak memory"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> StatsJson("stats-json",
+	llvm::cl::desc("Write the same statistics as --time-report to JSON file"),
+	llvm::cl::value_desc("file"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> UnsupportedJson("unsupported-json",
+	llvm::cl::desc("Write kinds, counts and locations of unsupported nodes to JSON file"),
+	llvm::cl::value_desc("file"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::list<std::string> DumpAstKinds("dump-ast-kinds",
+	llvm::cl::desc("Dump full AST of unsupported nodes of given kinds (e.g. SwitchStmt,CXXTryStmt)"),
+	llvm::cl::CommaSeparated, llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> Vectorize("vectorize",
+	llvm::cl::desc("Write element-wise counted loops over arrays as numpy slice expressions"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> NumpyArrays("numpy-arrays",
+	llvm::cl::desc("Emit local std::vector / std::array / c arrays of numbers as preallocated numpy arrays"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> NoSlots("no-slots",
+	llvm::cl::desc("Do not emit __slots__ for translated classes"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::list<std::string> DynamicClasses("dynamic-class",
+	llvm::cl::desc("Class which gets attributes dynamically and keeps __dict__ (may be repeated)"),
+	llvm::cl::value_desc("name"), llvm::cl::CommaSeparated, llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> NoFoldConstants("no-fold-constants",
+	llvm::cl::desc("Do not replace compile-time constant expressions with their values"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> FoldComments("fold-comments",
+	llvm::cl::desc("Keep c++ source of folded constant expressions as trailing comments"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> HoistInvariants("hoist-invariants",
+	llvm::cl::desc("Assign attribute chains, bound methods and len() which do not change in loop to locals before it"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<std::string> RulesFile("rules",
+	llvm::cl::desc("JSON file with translations of library calls, added to built-in rules"),
+	llvm::cl::value_desc("file"), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<bool> HeaderModules("header-modules",
+	llvm::cl::desc("Translate declarations of each header once into python module of its own (in -o directory) "
+		"and import them in files which include header"),
+	llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<unsigned> DeclThreads("decl-threads",
+	llvm::cl::desc("Threads translating top-level declarations of one file (0 = all cores). "
+		"Units parsed with precompiled preamble are translated by one thread, see --no-preamble"),
+	llvm::cl::init(1), llvm::cl::cat(Cpp2PythonCategory));
+
+static llvm::cl::opt<Backend> OutputBackend("backend",
+	llvm::cl::desc("Dialect of generated code"),
+	llvm::cl::values(
+		clEnumValN(Backend::Python, "python", "plain python (default)"),
+		clEnumValN(Backend::Numba, "numba", "free functions with typed signatures are compiled with numba @njit"),
+		clEnumValN(Backend::Cython, "cython", "cython .pyx modules with cdef typed locals and fields")),
+	llvm::cl::init(Backend::Python), llvm::cl::cat(Cpp2PythonCategory));
+
+// reports are written at every exit of main after translation
+struct RunReporter {
+	~RunReporter() {
+		printUnsupportedSummary(llvm::errs());
+		if (!UnsupportedJson.empty()) writeUnsupportedJson(UnsupportedJson);
+		if (TimeReport) printTimeReport(llvm::errs());
+		if (!StatsJson.empty()) writeStatsJson(StatsJson);
+	}
+};
+
+int main(int argc, char **argv) {
+	llvm::cl::HideUnrelatedOptions(Cpp2PythonCategory);
+	llvm::cl::ParseCommandLineOptions(argc, argv, "C++ to python translator\n");
+
+	TranslationOptions options;
+	options.headerFilter = HeaderFilterRegex;
+	options.translateDirs.assign(TranslateDirs.begin(), TranslateDirs.end());
+	options.vectorize = Vectorize;
+	options.backend = OutputBackend;
+	options.numpyArrays = NumpyArrays;
+	options.slots = !NoSlots;
+	options.dynamicClasses.assign(DynamicClasses.begin(), DynamicClasses.end());
+	options.foldConstants = !NoFoldConstants;
+	options.foldedSourceComments = FoldComments;
+	options.hoistInvariants = HoistInvariants;
+	options.rulesFile = RulesFile;
+	options.headerModules = HeaderModules;
+	options.declThreads = DeclThreads;
+	if (std::string error; !options.headerFilter.empty() && !llvm::Regex(options.headerFilter).isValid(error)) {
+		llvm::errs() << "invalid header filter: " << error << "\n";
+		return 1;
+	}
+	if (std::string error; !loadCallRules(options.rulesFile, error)) {
+		llvm::errs() << "invalid rules: " << error << "\n";
+		return 1;
+	}
+	setTranslationOptions(std::move(options));
+
+	if (TimeReport || !StatsJson.empty()) {
+		enableStats();
+	}
+	setDumpedKinds({ DumpAstKinds.begin(), DumpAstKinds.end() });
+	RunReporter reporter;
+
+	std::unique_ptr<clang::tooling::CompilationDatabase> compilations;
+	if (!BuildPath.empty()) {
+		std::string error;
+		compilations = clang::tooling::CompilationDatabase::autoDetectFromDirectory(BuildPath, error);
+		if (!compilations) {
+			llvm::errs() << "cannot load compilation database: " << error << "\n";
+			return 1;
+		}
+	}
+
+	TranslationSession session;
+	session.compilations = compilations.get();
+
+	std::unique_ptr<PreambleCache> preambles;
+	// server parses the same files again and again, their preambles are worth building without database too
+	if ((compilations || Server) && !NoPreamble) {
+		preambles = std::make_unique<PreambleCache>();
+		session.preambles = preambles.get();
+	}
+
+	std::unique_ptr<HeaderModuleRegistry> modules;
+	if (HeaderModules) {
+		modules = std::make_unique<HeaderModuleRegistry>(OutputDir);
+		session.modules = modules.get();
+	}
+
+	std::unique_ptr<TranslationCache> cache;
+	if (!CacheDir.empty()) {
+		cache = std::make_unique<TranslationCache>(CacheDir);
+		session.cache = cache.get();
+	}
+
+	if (Server) {
+		int result = runServer(std::cin, llvm::outs(), session);
+		if (cache) cache->printStats(llvm::errs());
+		if (preambles) preambles->printStats(llvm::errs());
+		return result;
+	}
+
+	std::vector<std::string> paths(InputPaths.begin(), InputPaths.end());
+	if (paths.empty() && compilations) {
+		paths = compilations->getAllFiles();
+	}
+	if (paths.empty()) {
+		llvm::errs() << "need to set file name\n";
+		return 1;
+	}
+
+	// "-" reads source from stdin and prints translation to console
+	if (paths.size() == 1 && paths.front() == "-") {
+		return translateStdin(llvm::outs(), session) ? 0 : 1;
+	}
+
+	// single file without output directory: print translation to console
+	if (paths.size() == 1 && OutputDir.empty() && !std::filesystem::is_directory(paths.front())) {
+		auto input = std::filesystem::absolute(paths.front()).string();
+		bool isTranslated = translateFile(input, llvm::outs(), session);
+		if (cache) cache->printStats(llvm::errs());
+		return isTranslated ? 0 : 1;
+	}
+
+	std::string error;
+	auto items = collectBatchItems(paths, OutputDir, error);
+	if (!error.empty()) {
+		llvm::errs() << error << "\n";
+		return 1;
+	}
+	if (items.empty()) {
+		llvm::errs() << "no c++ sources found\n";
+		return 1;
+	}
+
+	auto failed = runBatch(items, Jobs, session);
+	llvm::errs() << "translated " << items.size() - failed << " of " << items.size() << " files\n";
+	if (cache) cache->printStats(llvm::errs());
+	if (preambles) preambles->printStats(llvm::errs());
+	return failed == 0 ? 0 : 1;
+}